@@ -0,0 +1,205 @@
+#pragma once
+#include <mutex>
+#include <coroutine>
+#include <stdexcept>
+#include "SharedMutexReaderCount.h"
+
+// Coroutine counterpart of SharedMutex with the same admission rules: readers
+// enter while no writer holds the lock, a writer enters when nobody holds it.
+//
+//   co_await m.lock_async();        ...   m.unlock();
+//   co_await m.lock_shared_async(); ...   m.shared_unlock();
+//
+// A coroutine that cannot enter is suspended instead of blocking its thread.
+// Its waiter node is part of the awaiter, which lives in the coroutine frame,
+// so waiting never allocates. Waiters are resumed inline by the thread that
+// unlocks; co_await an executor's schedule() after acquiring to run elsewhere.
+// A resumed waiter that unlocks in turn does not resume the next one from its
+// own stack: it queues them for the outermost unlock() on the thread, which
+// resumes one after the other, so a long queue of writers handing the lock
+// on does not nest a frame per writer.
+class AsyncSharedMutex
+{
+	struct Waiter
+	{
+		Waiter *next = nullptr;
+		std::coroutine_handle<> handle;
+	};
+
+	struct WaiterList
+	{
+		Waiter *head = nullptr;
+		Waiter *tail = nullptr;
+
+		bool empty() const { return head == nullptr; }
+
+		void push(Waiter *w) {
+			w->next = nullptr;
+			if (tail)
+				tail->next = w;
+			else
+				head = w;
+			tail = w;
+		}
+
+		Waiter *pop() {
+			Waiter *w = head;
+			head = w->next;
+			if (!head)
+				tail = nullptr;
+			w->next = nullptr;
+			return w;
+		}
+
+		Waiter *take_all() {
+			Waiter *w = head;
+			head = tail = nullptr;
+			return w;
+		}
+	};
+
+	std::mutex m;
+	SharedMutexReaderCount<> nReaders;
+	bool hasWriter = false;
+	WaiterList readers;
+	std::uint64_t nWaitingReaders = 0;   // in readers, counted against the reader limit
+	WaiterList writers;
+
+	// Admitted waiters on this thread not yet resumed, and whether an unlock()
+	// further up its stack is resuming them.
+	struct Trampoline
+	{
+		WaiterList admitted;
+		bool running = false;
+	};
+
+	static Trampoline &trampoline() {
+		static thread_local Trampoline instance;
+		return instance;
+	}
+
+	static void resume(Waiter *w) {
+		Trampoline &t = trampoline();
+		while (w) {
+			Waiter *next = w->next;
+			t.admitted.push(w);
+			w = next;
+		}
+		if (t.running)
+			return;
+		t.running = true;
+		struct Stop {
+			Trampoline &t;
+			~Stop() { t.running = false; }
+		} stop{t};
+		// the frame holding a waiter may be destroyed as soon as it resumes
+		while (!t.admitted.empty())
+			t.admitted.pop()->handle.resume();
+	}
+
+	// Called with m held after the lock state changed. Grants the lock to
+	// waiters and returns them as a list to be resumed once m is released.
+	Waiter *admit() {
+		if (hasWriter)
+			return nullptr;
+		if (!readers.empty()) {
+			nReaders += nWaitingReaders;
+			nWaitingReaders = 0;
+			return readers.take_all();
+		}
+		if (nReaders == 0 && !writers.empty()) {
+			hasWriter = true;
+			return writers.pop();
+		}
+		return nullptr;
+	}
+
+public:
+	class LockAwaiter
+	{
+		AsyncSharedMutex &mutex;
+		Waiter waiter;
+	public:
+		explicit LockAwaiter(AsyncSharedMutex &mutex) : mutex(mutex) {
+		}
+
+		bool await_ready() const noexcept { return false; }
+
+		bool await_suspend(std::coroutine_handle<> handle) {
+			std::unique_lock<std::mutex> lock(mutex.m);
+			if (!mutex.hasWriter && mutex.nReaders == 0) {
+				mutex.hasWriter = true;
+				return false;
+			}
+			waiter.handle = handle;
+			mutex.writers.push(&waiter);
+			return true;
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+	class SharedLockAwaiter
+	{
+		AsyncSharedMutex &mutex;
+		Waiter waiter;
+	public:
+		explicit SharedLockAwaiter(AsyncSharedMutex &mutex) : mutex(mutex) {
+		}
+
+		bool await_ready() const noexcept { return false; }
+
+		bool await_suspend(std::coroutine_handle<> handle) {
+			std::unique_lock<std::mutex> lock(mutex.m);
+			mutex.nReaders.check(mutex.nWaitingReaders + 1);
+			if (!mutex.hasWriter) {
+				mutex.nReaders++;
+				return false;
+			}
+			waiter.handle = handle;
+			mutex.readers.push(&waiter);
+			mutex.nWaitingReaders++;
+			return true;
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+	AsyncSharedMutex() {
+	}
+
+	AsyncSharedMutex(const AsyncSharedMutex &) = delete;
+	AsyncSharedMutex &operator=(const AsyncSharedMutex &) = delete;
+
+	LockAwaiter lock_async() {
+		return LockAwaiter(*this);
+	}
+
+	SharedLockAwaiter lock_shared_async() {
+		return SharedLockAwaiter(*this);
+	}
+
+	void unlock() {
+		Waiter *admitted;
+		{
+			std::unique_lock<std::mutex> lock(m);
+			if (!hasWriter)
+				throw std::logic_error("not locked");
+			hasWriter = false;
+			admitted = admit();
+		}
+		resume(admitted);
+	}
+
+	void shared_unlock() {
+		Waiter *admitted;
+		{
+			std::unique_lock<std::mutex> lock(m);
+			if (nReaders == 0)
+				throw std::logic_error("not locked");
+			nReaders--;
+			admitted = admit();
+		}
+		resume(admitted);
+	}
+};
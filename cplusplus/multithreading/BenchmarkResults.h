@@ -0,0 +1,455 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/utsname.h>
+
+// Benchmark results kept across runs, so a lock change can be judged against
+// the numbers it replaced rather than from memory.
+//
+// A run is a set of named series, each holding one sample per repetition
+// (e.g. "throughput/SharedMutex/threads=8/writes=10/cs=16", ops/s), plus the
+// machine and build it ran on. Runs are stored as JSON; compare() matches the
+// series of two runs by name and tests whether the candidate samples differ
+// from the baseline with a two-sided Mann-Whitney U test, which assumes
+// nothing about the shape of the distributions.
+
+#if !defined(SHARED_MUTEX_BENCH_FLAGS)
+#define SHARED_MUTEX_BENCH_FLAGS "unknown"
+#endif
+
+namespace benchmark_results
+{
+	struct Machine
+	{
+		std::string cpu;
+		int cores = 0;
+		std::string kernel;
+		std::string compiler;
+		std::string flags;
+
+		static Machine current() {
+			Machine machine;
+			machine.cpu = "unknown";
+			std::ifstream cpuinfo("/proc/cpuinfo");
+			for (std::string line; std::getline(cpuinfo, line);) {
+				if (line.compare(0, 10, "model name") == 0 && line.find(':') != std::string::npos) {
+					machine.cpu = line.substr(line.find(':') + 2);
+					break;
+				}
+			}
+			machine.cores = (int)std::thread::hardware_concurrency();
+			utsname name;
+			if (uname(&name) == 0)
+				machine.kernel = std::string(name.sysname) + " " + name.release + " " + name.machine;
+#if defined(__clang__)
+			machine.compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+			machine.compiler = "gcc " __VERSION__;
+#else
+			machine.compiler = "unknown";
+#endif
+			machine.flags = SHARED_MUTEX_BENCH_FLAGS;
+			return machine;
+		}
+	};
+
+	struct Series
+	{
+		std::string name;
+		std::string unit;
+		bool higherIsBetter = true;
+		std::vector<double> samples;
+	};
+
+	inline double median(std::vector<double> values) {
+		if (values.empty())
+			return 0;
+		std::sort(values.begin(), values.end());
+		std::size_t n = values.size();
+		return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+	}
+
+	class JsonReader
+	{
+		std::istream &is;
+
+		[[noreturn]] void fail(const std::string &what) {
+			throw std::runtime_error("benchmark results: " + what);
+		}
+
+	public:
+		explicit JsonReader(std::istream &is) : is(is) {
+		}
+
+		char peek() {
+			is >> std::ws;
+			int c = is.peek();
+			if (c == EOF)
+				fail("unexpected end of input");
+			return (char)c;
+		}
+
+		void expect(char c) {
+			if (peek() != c)
+				fail(std::string("expected '") + c + "'");
+			is.get();
+		}
+
+		std::string string() {
+			expect('"');
+			std::string s;
+			for (int c = is.get(); c != '"'; c = is.get()) {
+				if (c == EOF)
+					fail("unterminated string");
+				if (c == '\\') {
+					c = is.get();
+					if (c == 'n')
+						c = '\n';
+					else if (c == 't')
+						c = '\t';
+				}
+				s += (char)c;
+			}
+			return s;
+		}
+
+		double number() {
+			peek();
+			double value;
+			if (!(is >> value))
+				fail("expected a number");
+			return value;
+		}
+
+		bool boolean() {
+			std::string word;
+			while (std::isalpha(peek()))
+				word += (char)is.get();
+			if (word != "true" && word != "false")
+				fail("expected true or false");
+			return word == "true";
+		}
+
+		// Calls member(key) for every member; member() must consume the value.
+		template<class Member>
+		void object(Member member) {
+			expect('{');
+			if (peek() == '}') {
+				is.get();
+				return;
+			}
+			for (;;) {
+				std::string key = string();
+				expect(':');
+				member(key);
+				if (peek() == '}') {
+					is.get();
+					return;
+				}
+				expect(',');
+			}
+		}
+
+		template<class Element>
+		void array(Element element) {
+			expect('[');
+			if (peek() == ']') {
+				is.get();
+				return;
+			}
+			for (;;) {
+				element();
+				if (peek() == ']') {
+					is.get();
+					return;
+				}
+				expect(',');
+			}
+		}
+
+		void skip() {
+			char c = peek();
+			if (c == '{')
+				object([this](const std::string &) { skip(); });
+			else if (c == '[')
+				array([this] { skip(); });
+			else if (c == '"')
+				string();
+			else if (c == 't' || c == 'f')
+				boolean();
+			else
+				number();
+		}
+	};
+
+	inline void write_string(std::ostream &os, const std::string &s) {
+		os << '"';
+		for (char c : s) {
+			if (c == '"' || c == '\\')
+				os << '\\';
+			if (c == '\n')
+				os << "\\n";
+			else if (c == '\t')
+				os << "\\t";
+			else
+				os << c;
+		}
+		os << '"';
+	}
+
+	class Results
+	{
+	public:
+		Machine machine;
+		std::string timestamp;
+		std::vector<Series> series;
+
+		// Appends one sample to the named series, creating it on first use.
+		void add(const std::string &name, const char *unit, bool higherIsBetter, double sample) {
+			for (Series &s : series) {
+				if (s.name == name) {
+					s.samples.push_back(sample);
+					return;
+				}
+			}
+			series.push_back(Series{name, unit, higherIsBetter, {sample}});
+		}
+
+		const Series *find(const std::string &name) const {
+			for (const Series &s : series)
+				if (s.name == name)
+					return &s;
+			return nullptr;
+		}
+
+		static std::string now() {
+			char text[32];
+			std::time_t t = std::time(nullptr);
+			std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&t));
+			return text;
+		}
+
+		void write_json(std::ostream &os) const {
+			os << "{\n  \"timestamp\": ";
+			write_string(os, timestamp);
+			os << ",\n  \"machine\": {\"cpu\": ";
+			write_string(os, machine.cpu);
+			os << ", \"cores\": " << machine.cores << ", \"kernel\": ";
+			write_string(os, machine.kernel);
+			os << ", \"compiler\": ";
+			write_string(os, machine.compiler);
+			os << ", \"flags\": ";
+			write_string(os, machine.flags);
+			os << "},\n  \"series\": [";
+			for (std::size_t i = 0; i < series.size(); i++) {
+				const Series &s = series[i];
+				os << (i ? ",\n    " : "\n    ") << "{\"name\": ";
+				write_string(os, s.name);
+				os << ", \"unit\": ";
+				write_string(os, s.unit);
+				os << ", \"higher_is_better\": " << (s.higherIsBetter ? "true" : "false") << ", \"samples\": [";
+				for (std::size_t j = 0; j < s.samples.size(); j++) {
+					char value[32];
+					std::snprintf(value, sizeof(value), "%.17g", s.samples[j]);
+					os << (j ? ", " : "") << value;
+				}
+				os << "]}";
+			}
+			os << "\n  ]\n}\n";
+		}
+
+		// Throws std::runtime_error on malformed input. Unknown members are skipped.
+		static Results read_json(std::istream &is) {
+			Results results;
+			JsonReader json(is);
+			json.object([&](const std::string &key) {
+				if (key == "timestamp") {
+					results.timestamp = json.string();
+				}
+				else if (key == "machine") {
+					Machine &m = results.machine;
+					json.object([&](const std::string &field) {
+						if (field == "cpu")
+							m.cpu = json.string();
+						else if (field == "cores")
+							m.cores = (int)json.number();
+						else if (field == "kernel")
+							m.kernel = json.string();
+						else if (field == "compiler")
+							m.compiler = json.string();
+						else if (field == "flags")
+							m.flags = json.string();
+						else
+							json.skip();
+					});
+				}
+				else if (key == "series") {
+					json.array([&] {
+						Series s;
+						json.object([&](const std::string &field) {
+							if (field == "name")
+								s.name = json.string();
+							else if (field == "unit")
+								s.unit = json.string();
+							else if (field == "higher_is_better")
+								s.higherIsBetter = json.boolean();
+							else if (field == "samples")
+								json.array([&] { s.samples.push_back(json.number()); });
+							else
+								json.skip();
+						});
+						results.series.push_back(s);
+					});
+				}
+				else {
+					json.skip();
+				}
+			});
+			return results;
+		}
+	};
+
+	struct MannWhitney
+	{
+		double u;   // pairs (a, b) with a > b, ties counting half
+		double p;   // two-sided
+	};
+
+	// Exact null distribution of U for small samples without ties: P(U <= u).
+	inline double exact_u_cdf(int n1, int n2, double u) {
+		// p[i][j][k] = P(U = k) for sizes i, j; the largest value comes from the
+		// first sample with probability i / (i + j) and then beats all j others.
+		std::vector<std::vector<std::vector<double>>> p(n1 + 1, std::vector<std::vector<double>>(n2 + 1));
+		for (int i = 0; i <= n1; i++) {
+			for (int j = 0; j <= n2; j++) {
+				p[i][j].assign(i * j + 1, 0.0);
+				if (i == 0 || j == 0) {
+					p[i][j][0] = 1;
+					continue;
+				}
+				for (int k = 0; k <= i * j; k++) {
+					double fromFirst = k >= j ? p[i - 1][j][k - j] : 0;
+					double fromSecond = k <= i * (j - 1) ? p[i][j - 1][k] : 0;
+					p[i][j][k] = (i * fromFirst + j * fromSecond) / (i + j);
+				}
+			}
+		}
+		double cdf = 0;
+		for (int k = 0; k <= (int)std::floor(u) && k <= n1 * n2; k++)
+			cdf += p[n1][n2][k];
+		return cdf;
+	}
+
+	// Two-sided Mann-Whitney U test. Exact for small samples without ties,
+	// otherwise the normal approximation with tie and continuity correction.
+	inline MannWhitney mann_whitney(const std::vector<double> &a, const std::vector<double> &b) {
+		int n1 = (int)a.size();
+		int n2 = (int)b.size();
+		if (n1 == 0 || n2 == 0)
+			return MannWhitney{0, 1};
+
+		std::vector<std::pair<double, int>> all;
+		for (double x : a)
+			all.push_back({x, 0});
+		for (double x : b)
+			all.push_back({x, 1});
+		std::sort(all.begin(), all.end());
+		int n = n1 + n2;
+		double rankSumA = 0;
+		double tieTerm = 0;
+		for (int i = 0; i < n;) {
+			int j = i;
+			while (j < n && all[j].first == all[i].first)
+				j++;
+			double rank = (i + 1 + j) / 2.0;
+			for (int k = i; k < j; k++)
+				if (all[k].second == 0)
+					rankSumA += rank;
+			double t = j - i;
+			tieTerm += t * t * t - t;
+			i = j;
+		}
+		double u = rankSumA - n1 * (n1 + 1) / 2.0;
+		double mean = n1 * n2 / 2.0;
+		double lower = std::min(u, n1 * n2 - u);
+
+		if (tieTerm == 0 && n1 * n2 <= 400)
+			return MannWhitney{u, std::min(1.0, 2 * exact_u_cdf(n1, n2, lower))};
+		double variance = n1 * n2 / 12.0 * ((n + 1) - tieTerm / ((double)n * (n - 1)));
+		if (variance <= 0)
+			return MannWhitney{u, 1};
+		double z = std::max(0.0, std::fabs(u - mean) - 0.5) / std::sqrt(variance);
+		return MannWhitney{u, std::erfc(z / std::sqrt(2.0))};
+	}
+
+	// The smallest p mann_whitney() can report for samples of these sizes, when
+	// they do not overlap at all. With 3 samples per side it is 0.1, so no
+	// difference is ever significant at 0.05; 4 per side are needed.
+	inline double minimum_p(int n1, int n2) {
+		std::vector<double> a, b;
+		for (int i = 0; i < n1; i++)
+			a.push_back(i);
+		for (int i = 0; i < n2; i++)
+			b.push_back(n1 + i);
+		return mann_whitney(a, b).p;
+	}
+
+	// missing: only in the baseline, e.g. a mode that crashed or was removed;
+	// added: only in the candidate.
+	enum class Verdict { unchanged, improved, regressed, inconclusive, missing, added };
+
+	struct Comparison
+	{
+		std::string name;
+		std::string unit;
+		double baseline;    // medians, NaN for a run without the series
+		double candidate;
+		double change;      // percent, positive when the candidate is better
+		double p;
+		Verdict verdict;
+	};
+
+	// Every series of either run, baseline order first. A change is flagged
+	// only when it is both larger than thresholdPercent and significant at
+	// alpha. Series with too few samples to ever reach alpha are inconclusive
+	// rather than unchanged, and series in only one run are missing or added.
+	inline std::vector<Comparison> compare(const Results &baseline, const Results &candidate, double thresholdPercent, double alpha) {
+		std::vector<Comparison> comparisons;
+		double none = std::nan("");
+		for (const Series &b : baseline.series) {
+			const Series *c = candidate.find(b.name);
+			if (!c) {
+				comparisons.push_back(Comparison{b.name, b.unit, median(b.samples), none, none, none, Verdict::missing});
+				continue;
+			}
+			Comparison comparison;
+			comparison.name = b.name;
+			comparison.unit = b.unit;
+			comparison.baseline = median(b.samples);
+			comparison.candidate = median(c->samples);
+			double relative = comparison.baseline == 0 ? 0 : (comparison.candidate - comparison.baseline) / std::fabs(comparison.baseline) * 100;
+			comparison.change = b.higherIsBetter ? relative : -relative;
+			comparison.p = mann_whitney(b.samples, c->samples).p;
+			comparison.verdict = Verdict::unchanged;
+			if (minimum_p((int)b.samples.size(), (int)c->samples.size()) >= alpha)
+				comparison.verdict = Verdict::inconclusive;
+			else if (comparison.p < alpha && std::fabs(comparison.change) > thresholdPercent)
+				comparison.verdict = comparison.change > 0 ? Verdict::improved : Verdict::regressed;
+			comparisons.push_back(comparison);
+		}
+		for (const Series &c : candidate.series)
+			if (!baseline.find(c.name))
+				comparisons.push_back(Comparison{c.name, c.unit, none, median(c.samples), none, none, Verdict::added});
+		return comparisons;
+	}
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include "SharedMutex.h"
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#if defined(__RTM__)
+#include <immintrin.h>
+#include <cpuid.h>
+#define SHARED_MUTEX_HAS_RTM 1
+#endif
+
+// SharedMutex with a speculative fast path for short critical sections.
+//
+// Critical sections are passed in as callables, so they can be re-executed:
+//   m.write([&] { std::atomic_ref<int>(table[i]).store(v, std::memory_order_relaxed); });
+//   int v = m.read([&] { return std::atomic_ref<int>(table[i]).load(std::memory_order_relaxed); });
+//
+// When compiled with -mrtm and running on a CPU with RTM, both read and write
+// sections first run as hardware transactions, so readers and writers touching
+// disjoint data run concurrently. Elsewhere, read sections run optimistically
+// against a sequence counter and are retried if a writer intervened, while
+// write sections serialize on the underlying SharedMutex.
+//
+// A read section may run concurrently with a write section on the same data,
+// and its result is discarded in that case. Plain reads racing with writes
+// are undefined behavior, not merely stale, so both sections must access the
+// protected data only through relaxed atomics (std::atomic members or
+// std::atomic_ref); the sequence counter orders them. A read section must
+// also only copy what it loads: no allocation, no pointer chasing through the
+// protected data, no side effects.
+class ElidedSharedMutex
+{
+	SharedMutex m;
+	std::atomic<unsigned> sequence{0};      // odd while a writer holds m
+	std::atomic<int> nonSpeculative{0};     // sections running under m; aborts transactions
+
+	static const int optimisticAttempts = 4;
+
+	template<class F>
+	auto readLocked(F &f) -> decltype(f()) {
+		nonSpeculative.fetch_add(1);
+		m.shared_lock();
+		struct Unlock {
+			ElidedSharedMutex &self;
+			~Unlock() { self.m.shared_unlock(); self.nonSpeculative.fetch_sub(1); }
+		} unlock{*this};
+		return f();
+	}
+
+#if defined(SHARED_MUTEX_HAS_RTM)
+	static bool rtmSupported() {
+		static const bool supported = [] {
+			unsigned eax, ebx, ecx, edx;
+			if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+				return false;
+			return (ebx & (1u << 11)) != 0;
+		}();
+		return supported;
+	}
+
+	void waitNonSpeculative() {
+		while (nonSpeculative.load(std::memory_order_relaxed) != 0)
+			_mm_pause();
+	}
+#endif
+
+public:
+	ElidedSharedMutex() {
+	}
+
+	template<class F>
+	auto read(F f) -> decltype(f()) {
+#if defined(SHARED_MUTEX_HAS_RTM)
+		if (rtmSupported()) {
+			for (int attempt = 0; attempt < optimisticAttempts; attempt++) {
+				unsigned status = _xbegin();
+				if (status == _XBEGIN_STARTED) {
+					if (nonSpeculative.load(std::memory_order_relaxed) != 0)
+						_xabort(0xff);
+					if constexpr (std::is_void_v<decltype(f())>) {
+						f();
+						_xend();
+						return;
+					}
+					else {
+						auto result = f();
+						_xend();
+						return result;
+					}
+				}
+				if (!(status & (_XABORT_RETRY | _XABORT_EXPLICIT)))
+					break;
+				waitNonSpeculative();
+			}
+			return readLocked(f);
+		}
+#endif
+		for (int attempt = 0; attempt < optimisticAttempts; attempt++) {
+			unsigned before = sequence.load(std::memory_order_acquire);
+			if (before & 1) {
+				std::this_thread::yield();
+				continue;
+			}
+			if constexpr (std::is_void_v<decltype(f())>) {
+				f();
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (sequence.load(std::memory_order_relaxed) == before)
+					return;
+			}
+			else {
+				auto result = f();
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (sequence.load(std::memory_order_relaxed) == before)
+					return result;
+			}
+		}
+		return readLocked(f);
+	}
+
+	template<class F>
+	auto write(F f) -> decltype(f()) {
+#if defined(SHARED_MUTEX_HAS_RTM)
+		if (rtmSupported()) {
+			for (int attempt = 0; attempt < optimisticAttempts; attempt++) {
+				unsigned status = _xbegin();
+				if (status == _XBEGIN_STARTED) {
+					if (nonSpeculative.load(std::memory_order_relaxed) != 0)
+						_xabort(0xff);
+					if constexpr (std::is_void_v<decltype(f())>) {
+						f();
+						_xend();
+						return;
+					}
+					else {
+						auto result = f();
+						_xend();
+						return result;
+					}
+				}
+				if (!(status & (_XABORT_RETRY | _XABORT_EXPLICIT)))
+					break;
+				waitNonSpeculative();
+			}
+		}
+#endif
+		nonSpeculative.fetch_add(1);
+		m.lock();
+		sequence.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		struct Unlock {
+			ElidedSharedMutex &self;
+			~Unlock() {
+				self.sequence.fetch_add(1, std::memory_order_release);
+				self.m.unlock();
+				self.nonSpeculative.fetch_sub(1);
+			}
+		} unlock{*this};
+		return f();
+	}
+
+	// True if write sections can run as hardware transactions on this machine.
+	static bool speculative() {
+#if defined(SHARED_MUTEX_HAS_RTM)
+		return rtmSupported();
+#else
+		return false;
+#endif
+	}
+};
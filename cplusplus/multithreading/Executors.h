@@ -0,0 +1,121 @@
+#pragma once
+#include <mutex>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Minimal executors for driving coroutines and continuations in tests.
+// Both provide post(f) and an awaitable schedule() that resumes the awaiting
+// coroutine on the executor.
+
+template<class Executor>
+class ScheduleAwaiter
+{
+	Executor &executor;
+public:
+	explicit ScheduleAwaiter(Executor &executor) : executor(executor) {
+	}
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) { executor.post([handle] { handle.resume(); }); }
+	void await_resume() const noexcept {}
+};
+
+// Queues work until the owner drains it with run() on its own thread.
+class ManualExecutor
+{
+	std::mutex m;
+	std::deque<std::function<void()>> queue;
+public:
+	ManualExecutor() {
+	}
+
+	void post(std::function<void()> f) {
+		std::unique_lock<std::mutex> lock(m);
+		queue.push_back(std::move(f));
+	}
+
+	ScheduleAwaiter<ManualExecutor> schedule() {
+		return ScheduleAwaiter<ManualExecutor>(*this);
+	}
+
+	bool run_one() {
+		std::function<void()> f;
+		{
+			std::unique_lock<std::mutex> lock(m);
+			if (queue.empty())
+				return false;
+			f = std::move(queue.front());
+			queue.pop_front();
+		}
+		f();
+		return true;
+	}
+
+	// Runs queued work, including work posted while running, until the queue is empty.
+	int run() {
+		int n = 0;
+		while (run_one())
+			n++;
+		return n;
+	}
+};
+
+// Fixed set of worker threads; the destructor drains the queue and joins them.
+class ThreadPoolExecutor
+{
+	std::mutex m;
+	std::condition_variable cond_var;
+	std::deque<std::function<void()>> queue;
+	bool stopping = false;
+	std::vector<std::thread> threads;
+
+	void worker() {
+		for (;;) {
+			std::function<void()> f;
+			{
+				std::unique_lock<std::mutex> lock(m);
+				while (queue.empty() && !stopping)
+					cond_var.wait(lock);
+				if (queue.empty())
+					return;
+				f = std::move(queue.front());
+				queue.pop_front();
+			}
+			f();
+		}
+	}
+
+public:
+	explicit ThreadPoolExecutor(unsigned nThreads = std::thread::hardware_concurrency()) {
+		if (nThreads == 0)
+			nThreads = 1;
+		for (unsigned i = 0; i < nThreads; i++)
+			threads.emplace_back(&ThreadPoolExecutor::worker, this);
+	}
+
+	~ThreadPoolExecutor() {
+		{
+			std::unique_lock<std::mutex> lock(m);
+			stopping = true;
+		}
+		cond_var.notify_all();
+		for (auto &t : threads)
+			t.join();
+	}
+
+	void post(std::function<void()> f) {
+		{
+			std::unique_lock<std::mutex> lock(m);
+			queue.push_back(std::move(f));
+		}
+		cond_var.notify_one();
+	}
+
+	ScheduleAwaiter<ThreadPoolExecutor> schedule() {
+		return ScheduleAwaiter<ThreadPoolExecutor>(*this);
+	}
+};
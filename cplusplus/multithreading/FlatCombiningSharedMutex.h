@@ -0,0 +1,133 @@
+#pragma once
+#include "SharedMutex.h"
+#include <atomic>
+#include <exception>
+#include <thread>
+
+// SharedMutex with a flat-combining write path for tiny write sections.
+//
+//   m.combine([&] { counter++; });
+//
+// A writer publishes its section in a slot and whichever writer becomes the
+// combiner takes the exclusive lock once and runs every published section, so
+// one lock handoff is paid for a whole batch of updates. combine() returns
+// after the caller's own section has run, on whichever thread ran it; a
+// section must therefore not depend on thread identity.
+//
+// Readers and long writers use shared_lock()/lock() as with SharedMutex and
+// are excluded from combined sections in the usual way.
+class FlatCombiningSharedMutex
+{
+	struct Operation
+	{
+		void (*run)(void *context);
+		void *context;
+		std::exception_ptr exception;
+		std::atomic<bool> done{false};
+	};
+
+	struct alignas(64) Slot
+	{
+		std::atomic<Operation *> operation{nullptr};
+	};
+
+	static const int nSlots = 128;
+	static const int maxPasses = 4;
+
+	SharedMutex m;
+	std::atomic<bool> combining{false};
+	std::atomic<int> slotsInUse{0};   // high-water mark, bounds the combiner's scan
+	Slot slots[nSlots];
+
+	static unsigned homeSlot() {
+		static std::atomic<unsigned> nextThread{0};
+		static thread_local unsigned home = nextThread.fetch_add(1, std::memory_order_relaxed) % nSlots;
+		return home;
+	}
+
+	// With every slot taken, waits for a combiner to free one. Slots are read
+	// before the CAS so a full table is scanned without taking cache lines
+	// exclusively, and each fruitless pass yields the CPU to the combiner.
+	void publish(Operation *operation) {
+		for (unsigned i = homeSlot(), failed = 0;; i = (i + 1) % nSlots) {
+			Operation *expected = nullptr;
+			if (!slots[i].operation.load(std::memory_order_relaxed) &&
+				slots[i].operation.compare_exchange_strong(expected, operation, std::memory_order_release, std::memory_order_relaxed)) {
+				int used = slotsInUse.load(std::memory_order_relaxed);
+				while (used <= (int)i && !slotsInUse.compare_exchange_weak(used, (int)i + 1, std::memory_order_relaxed))
+					;
+				return;
+			}
+			if (++failed % nSlots == 0)
+				std::this_thread::yield();
+		}
+	}
+
+	// Runs with the exclusive lock held. Keeps scanning while passes find work,
+	// so writers arriving during the batch are picked up without a new handoff.
+	void applyPending() {
+		for (int pass = 0; pass < maxPasses; pass++) {
+			bool found = false;
+			int used = slotsInUse.load(std::memory_order_relaxed);
+			for (int i = 0; i < used; i++) {
+				Slot &slot = slots[i];
+				Operation *operation = slot.operation.load(std::memory_order_acquire);
+				if (!operation)
+					continue;
+				try {
+					operation->run(operation->context);
+				}
+				catch (...) {
+					operation->exception = std::current_exception();
+				}
+				slot.operation.store(nullptr, std::memory_order_relaxed);
+				operation->done.store(true, std::memory_order_release);
+				found = true;
+			}
+			if (!found)
+				return;
+		}
+	}
+
+public:
+	FlatCombiningSharedMutex() {
+	}
+
+	template<class F>
+	void combine(F f) {
+		Operation operation;
+		operation.run = [](void *context) { (*static_cast<F *>(context))(); };
+		operation.context = &f;
+		publish(&operation);
+
+		while (!operation.done.load(std::memory_order_acquire)) {
+			if (!combining.load(std::memory_order_relaxed) && !combining.exchange(true, std::memory_order_acquire)) {
+				m.lock();
+				applyPending();
+				m.unlock();
+				combining.store(false, std::memory_order_release);
+			}
+			else {
+				std::this_thread::yield();
+			}
+		}
+		if (operation.exception)
+			std::rethrow_exception(operation.exception);
+	}
+
+	void lock() {
+		m.lock();
+	}
+
+	void unlock() {
+		m.unlock();
+	}
+
+	void shared_lock() {
+		m.shared_lock();
+	}
+
+	void shared_unlock() {
+		m.shared_unlock();
+	}
+};
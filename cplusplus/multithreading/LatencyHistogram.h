@@ -0,0 +1,187 @@
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+
+// Log-linear latency histogram in the style of HdrHistogram. Values below 32
+// get exact buckets; above that every power of two is split into 16 buckets,
+// so a recorded value is reported within ~6% of its true value. Values are
+// nanoseconds and are clamped to 2^40 (about 18 minutes).
+class LatencyHistogram
+{
+public:
+	static const int subBucketBits = 5;
+	static const int maxValueBits = 40;
+	static const int nBuckets = (maxValueBits - subBucketBits) * (1 << (subBucketBits - 1)) + (1 << subBucketBits);
+
+	static int bucket_of(std::uint64_t value) {
+		const std::uint64_t subBuckets = 1ull << subBucketBits;
+		const std::uint64_t halfSubBuckets = subBuckets / 2;
+		if (value >= (1ull << maxValueBits))
+			value = (1ull << maxValueBits) - 1;
+		if (value < subBuckets)
+			return (int)value;
+		int exponent = 63 - __builtin_clzll(value);
+		int shift = exponent - subBucketBits + 1;
+		return (int)(shift * halfSubBuckets + (value >> shift));
+	}
+
+	// Largest value that falls into bucket i.
+	static std::uint64_t bucket_max(int i) {
+		const int subBuckets = 1 << subBucketBits;
+		const int halfSubBuckets = subBuckets / 2;
+		if (i < subBuckets)
+			return (std::uint64_t)i;
+		int shift = i / halfSubBuckets - 1;
+		std::uint64_t mantissa = (std::uint64_t)(i - shift * halfSubBuckets);
+		return ((mantissa + 1) << shift) - 1;
+	}
+
+private:
+	std::uint64_t counts[nBuckets] = {};
+	std::uint64_t total = 0;
+	std::uint64_t maxValue = 0;
+
+public:
+	LatencyHistogram() {
+	}
+
+	void record(std::uint64_t value) {
+		counts[bucket_of(value)]++;
+		total++;
+		if (value > maxValue)
+			maxValue = value;
+	}
+
+	void add(int bucket, std::uint64_t n, std::uint64_t largest) {
+		counts[bucket] += n;
+		total += n;
+		if (largest > maxValue)
+			maxValue = largest;
+	}
+
+	void merge(const LatencyHistogram &other) {
+		for (int i = 0; i < nBuckets; i++)
+			counts[i] += other.counts[i];
+		total += other.total;
+		if (other.maxValue > maxValue)
+			maxValue = other.maxValue;
+	}
+
+	std::uint64_t count() const {
+		return total;
+	}
+
+	std::uint64_t max() const {
+		return maxValue;
+	}
+
+	// Value at or below which `percent` of the recorded values fall, reported
+	// as the upper edge of its bucket and never above max().
+	std::uint64_t percentile(double percent) const {
+		if (total == 0)
+			return 0;
+		std::uint64_t rank = (std::uint64_t)std::ceil(percent / 100.0 * total);
+		if (rank < 1)
+			rank = 1;
+		std::uint64_t seen = 0;
+		for (int i = 0; i < nBuckets; i++) {
+			seen += counts[i];
+			if (seen >= rank)
+				return bucket_max(i) < maxValue ? bucket_max(i) : maxValue;
+		}
+		return maxValue;
+	}
+
+	// One line: "<label> count=N p50=.. p99=.. p99.9=.. max=.. (ns)".
+	void print_text(std::ostream &os, const std::string &label) const {
+		char line[256];
+		std::snprintf(line, sizeof line, "%s count=%llu p50=%llu p99=%llu p99.9=%llu max=%llu\n", label.c_str(),
+			(unsigned long long)count(), (unsigned long long)percentile(50), (unsigned long long)percentile(99),
+			(unsigned long long)percentile(99.9), (unsigned long long)max());
+		os << line;
+	}
+
+	// JSON object with the same fields as print_text().
+	void print_json(std::ostream &os) const {
+		char line[256];
+		std::snprintf(line, sizeof line, "{\"count\": %llu, \"p50\": %llu, \"p99\": %llu, \"p99.9\": %llu, \"max\": %llu}",
+			(unsigned long long)count(), (unsigned long long)percentile(50), (unsigned long long)percentile(99),
+			(unsigned long long)percentile(99.9), (unsigned long long)max());
+		os << line;
+	}
+};
+
+// LatencyHistogram that many threads record into without a lock. Each thread
+// writes its own stripe, allocated on first use, and snapshot() merges them.
+class StripedLatencyHistogram
+{
+	static const int nStripes = 16;
+
+	struct Stripe
+	{
+		std::atomic<std::uint64_t> counts[LatencyHistogram::nBuckets] = {};
+		std::atomic<std::uint64_t> maxValue{0};
+	};
+
+	std::atomic<Stripe *> stripes[nStripes] = {};
+
+	static int stripeIndex() {
+		static std::atomic<int> nextThread{0};
+		static thread_local int index = nextThread.fetch_add(1, std::memory_order_relaxed) % nStripes;
+		return index;
+	}
+
+	Stripe &stripe() {
+		std::atomic<Stripe *> &slot = stripes[stripeIndex()];
+		Stripe *s = slot.load(std::memory_order_acquire);
+		if (s)
+			return *s;
+		Stripe *created = new Stripe;
+		if (slot.compare_exchange_strong(s, created, std::memory_order_acq_rel))
+			return *created;
+		delete created;
+		return *s;
+	}
+
+public:
+	StripedLatencyHistogram() {
+	}
+
+	~StripedLatencyHistogram() {
+		for (auto &slot : stripes)
+			delete slot.load(std::memory_order_relaxed);
+	}
+
+	StripedLatencyHistogram(const StripedLatencyHistogram &) = delete;
+	StripedLatencyHistogram &operator=(const StripedLatencyHistogram &) = delete;
+
+	void record(std::uint64_t value) {
+		Stripe &s = stripe();
+		s.counts[LatencyHistogram::bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+		std::uint64_t largest = s.maxValue.load(std::memory_order_relaxed);
+		while (value > largest && !s.maxValue.compare_exchange_weak(largest, value, std::memory_order_relaxed))
+			;
+	}
+
+	// Merges all stripes. Values recorded in another unit (e.g. TSC ticks) are
+	// converted by dividing by `divisor`, at the cost of one more bucket of error.
+	LatencyHistogram snapshot(double divisor = 1.0) const {
+		LatencyHistogram merged;
+		for (auto &slot : stripes) {
+			const Stripe *s = slot.load(std::memory_order_acquire);
+			if (!s)
+				continue;
+			for (int i = 0; i < LatencyHistogram::nBuckets; i++) {
+				std::uint64_t n = s->counts[i].load(std::memory_order_relaxed);
+				if (n)
+					merged.add(LatencyHistogram::bucket_of((std::uint64_t)(LatencyHistogram::bucket_max(i) / divisor)), n, 0);
+			}
+			merged.add(0, 0, (std::uint64_t)(s->maxValue.load(std::memory_order_relaxed) / divisor));
+		}
+		return merged;
+	}
+};
@@ -0,0 +1,549 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Systematic interleaving explorer for lock implementations, in the spirit of
+// CHESS and Relacy.
+//
+// A lock under test is compiled against model_check::Mutex,
+// ConditionVariable and Atomic<T> instead of the std types (SharedMutex takes
+// them through SHARED_MUTEX_MUTEX, SHARED_MUTEX_CONDITION_VARIABLE and
+// SHARED_MUTEX_ATOMIC). Model threads run one at a time, and every operation
+// on a model primitive is a scheduling point where the explorer decides which
+// thread runs next. explore() runs a scenario once per distinct schedule,
+// depth first, with at most `preemptionBound` switches away from a thread
+// that could have continued; most concurrency bugs need only one or two.
+//
+// An execution fails, printing the schedule that led there and aborting, if
+// - a check() inside the scenario fails (e.g. mutual exclusion),
+// - no thread can run while some have not finished (deadlock or lost wakeup),
+// - it exceeds maxSteps scheduling points (no progress).
+//
+// Memory orders are modelled as store buffering (TSO, the x86 model): an
+// Atomic store weaker than seq_cst waits in the storing thread's buffer,
+// seen by that thread's own loads but not yet by others, so later loads of
+// other variables can overtake it (the reordering that breaks Dekker-style
+// handshakes built on release/acquire). Each buffer drains oldest first, at
+// any scheduling point the explorer chooses (counted like a preemption), at
+// the latest maxStoreDelay scheduling points after the store, and entirely
+// before a seq_cst store, a read-modify-write, a notify, a mutex operation or
+// blocking. Reorderings weaker machines also allow for relaxed and
+// acquire/release accesses (load-load, store-store, stores seen in different
+// orders by different threads) are not explored; modelling them needs
+// per-variable store histories as in Relacy and CDSChecker.
+// Condition variables wake waiters in FIFO order and never spuriously; timed
+// waits may time out at any scheduling point.
+namespace model_check
+{
+	struct Options
+	{
+		int preemptionBound = 2;
+		int maxSteps = 10000;
+		int maxStoreDelay = 8;   // 0 makes every store visible at once
+	};
+
+	class Scheduler
+	{
+		struct Thread
+		{
+			const void *blockedOn = nullptr;
+			bool finished = false;
+		};
+
+		// A store not yet visible to other threads; commit() makes the
+		// thread's oldest store to `object` visible.
+		struct BufferedStore
+		{
+			void *object;
+			void (*commit)(void *object, int thread);
+			int step;
+		};
+
+		struct Choice
+		{
+			std::vector<int> candidates;   // default first; -2 - t drains t's oldest store
+			int index;
+			bool currentEnabled;
+			int preemptionsBefore;
+		};
+
+		Options options;
+		std::mutex batonMutex;              // real primitives hand the baton over
+		std::condition_variable batonChanged;
+		int active = -1;
+		int nFinished = 0;
+		std::vector<Thread> threads;
+		std::vector<std::deque<BufferedStore>> buffers;   // per thread, oldest first
+		std::vector<Choice> choices;
+		std::vector<int> prefix;            // candidate indexes replayed from the last backtrack
+		int steps = 0;
+		int preemptions = 0;
+
+		static int &self() {
+			static thread_local int id = -1;
+			return id;
+		}
+
+		// Picks the next thread and records the choice, or returns -1 if none can
+		// run. With `drains`, may instead return -2 - t to drain thread t's
+		// oldest buffered store before the current thread goes on.
+		int choose(bool drains = false) {
+			int current = self();
+			bool currentEnabled = current >= 0 && !threads[current].finished && !threads[current].blockedOn;
+			std::vector<int> candidates;
+			if (currentEnabled)
+				candidates.push_back(current);
+			for (int t = 0; t < (int)threads.size(); t++)
+				if (t != current && !threads[t].finished && !threads[t].blockedOn)
+					candidates.push_back(t);
+			if (drains && currentEnabled)
+				for (int t = 0; t < (int)threads.size(); t++)
+					if (!buffers[t].empty())
+						candidates.push_back(-2 - t);
+			if (candidates.empty())
+				return -1;
+			int index = choices.size() < prefix.size() ? prefix[choices.size()] : 0;
+			choices.push_back(Choice{candidates, index, currentEnabled, preemptions});
+			if (currentEnabled && index > 0)
+				preemptions++;
+			return candidates[index];
+		}
+
+		void commit_oldest(int thread) {
+			BufferedStore store = buffers[thread].front();
+			buffers[thread].pop_front();
+			store.commit(store.object, thread);
+		}
+
+		void drain(int thread) {
+			while (!buffers[thread].empty())
+				commit_oldest(thread);
+		}
+
+		void drain_expired() {
+			for (int t = 0; t < (int)buffers.size(); t++)
+				while (!buffers[t].empty() && steps - buffers[t].front().step >= options.maxStoreDelay)
+					commit_oldest(t);
+		}
+
+		void transfer(int next) {
+			std::unique_lock<std::mutex> lock(batonMutex);
+			active = next;
+			batonChanged.notify_all();
+			batonChanged.wait(lock, [&] { return active == self(); });
+		}
+
+		// Moves to the deepest choice with an untried candidate within the
+		// preemption bound. Returns false when every schedule has been run.
+		bool backtrack() {
+			while (!choices.empty()) {
+				const Choice &c = choices.back();
+				int next = c.index + 1;
+				// every candidate but the first is a preemption if the current thread could run
+				if (next < (int)c.candidates.size() && c.preemptionsBefore + (c.currentEnabled ? 1 : 0) <= options.preemptionBound) {
+					prefix.clear();
+					for (std::size_t i = 0; i + 1 < choices.size(); i++)
+						prefix.push_back(choices[i].index);
+					prefix.push_back(next);
+					return true;
+				}
+				choices.pop_back();
+			}
+			return false;
+		}
+
+		std::string schedule() const {
+			std::string text;
+			int last = -2;
+			for (const Choice &c : choices) {
+				int t = c.candidates[c.index];
+				if (t != last) {
+					if (!text.empty())
+						text += ' ';
+					// fN: thread N's oldest buffered store became visible
+					if (t < -1)
+						text += 'f';
+					text += std::to_string(t < -1 ? -2 - t : t);
+				}
+				last = t < -1 ? -2 : t;
+			}
+			return text;
+		}
+
+	public:
+		explicit Scheduler(Options options) : options(options) {
+		}
+
+		static Scheduler *&current() {
+			static Scheduler *scheduler = nullptr;
+			return scheduler;
+		}
+
+		static int thread_id() {
+			return self();
+		}
+
+		[[noreturn]] void fail(const std::string &what) {
+			std::fprintf(stderr, "model check failed: %s\n  schedule (thread switches): %s\n", what.c_str(), schedule().c_str());
+			std::fflush(stderr);
+			std::abort();
+		}
+
+		// Called by a model thread before each visible operation.
+		void schedule_point() {
+			if (++steps > options.maxSteps)
+				fail("no progress after " + std::to_string(options.maxSteps) + " steps");
+			drain_expired();
+			int next;
+			while ((next = choose(true)) < -1)
+				commit_oldest(-2 - next);
+			if (next != self())
+				transfer(next);
+		}
+
+		bool buffers_stores() const {
+			return options.maxStoreDelay > 0;
+		}
+
+		// Queues a store by the calling thread, made visible later by commit().
+		void buffer_store(void *object, void (*commit)(void *object, int thread)) {
+			buffers[self()].push_back(BufferedStore{object, commit, steps});
+		}
+
+		// Makes the calling thread's buffered stores visible, as a full fence.
+		void fence() {
+			drain(self());
+		}
+
+		// Parks the calling thread until wake_all(object).
+		void block(const void *object) {
+			fence();
+			threads[self()].blockedOn = object;
+			int next = choose();
+			if (next < 0)
+				fail("deadlock: every unfinished thread is blocked (lost wakeup?)");
+			transfer(next);
+		}
+
+		void wake_all(const void *object) {
+			for (Thread &t : threads)
+				if (t.blockedOn == object)
+					t.blockedOn = nullptr;
+		}
+
+		void wake_thread(int id) {
+			threads[id].blockedOn = nullptr;
+		}
+
+		// Runs the scenario under one schedule; returns false once all have run.
+		template<class Scenario>
+		bool run_once() {
+			Scenario scenario;
+			int n = scenario.threads();
+			threads.assign(n, Thread());
+			buffers.assign(n, std::deque<BufferedStore>());
+			choices.clear();
+			nFinished = 0;
+			steps = 0;
+			preemptions = 0;
+
+			std::vector<std::thread> workers;
+			for (int t = 0; t < n; t++) {
+				workers.emplace_back([&, t] {
+					self() = t;
+					{
+						std::unique_lock<std::mutex> lock(batonMutex);
+						batonChanged.wait(lock, [&] { return active == t; });
+					}
+					scenario.run(t);
+					std::unique_lock<std::mutex> lock(batonMutex);
+					threads[t].finished = true;
+					nFinished++;
+					int next = choose();
+					if (next < 0 && nFinished < n)
+						fail("deadlock: every unfinished thread is blocked (lost wakeup?)");
+					active = next;
+					batonChanged.notify_all();
+				});
+			}
+			{
+				std::unique_lock<std::mutex> lock(batonMutex);
+				active = choose();
+				batonChanged.notify_all();
+				batonChanged.wait(lock, [&] { return active == -1 && nFinished == n; });
+			}
+			for (auto &w : workers)
+				w.join();
+			for (int t = 0; t < n; t++)
+				drain(t);
+			scenario.finish();
+			return backtrack();
+		}
+	};
+
+	struct Result
+	{
+		long long executions = 0;
+	};
+
+	// Runs Scenario under every schedule within the preemption bound. Scenario
+	// is default-constructed for each execution and provides threads(),
+	// run(thread) and finish(), called after all threads have returned.
+	template<class Scenario>
+	Result explore(Options options = Options())
+	{
+		Scheduler scheduler(options);
+		Scheduler::current() = &scheduler;
+		Result result;
+		bool more = true;
+		while (more) {
+			more = scheduler.run_once<Scenario>();
+			result.executions++;
+		}
+		Scheduler::current() = nullptr;
+		return result;
+	}
+
+	inline void check(bool condition, const char *what) {
+		if (!condition)
+			Scheduler::current()->fail(what);
+	}
+
+	// Lets the explorer switch threads here, e.g. inside a critical section.
+	inline void yield() {
+		Scheduler::current()->schedule_point();
+	}
+
+	class Mutex
+	{
+		int owner = -1;
+
+	public:
+		void lock() {
+			Scheduler &s = *Scheduler::current();
+			for (;;) {
+				s.schedule_point();
+				s.fence();
+				if (owner < 0) {
+					owner = Scheduler::thread_id();
+					return;
+				}
+				s.block(this);
+			}
+		}
+
+		bool try_lock() {
+			Scheduler &s = *Scheduler::current();
+			s.schedule_point();
+			s.fence();
+			if (owner >= 0)
+				return false;
+			owner = Scheduler::thread_id();
+			return true;
+		}
+
+		void unlock() {
+			Scheduler &s = *Scheduler::current();
+			s.schedule_point();
+			s.fence();
+			check(owner == Scheduler::thread_id(), "mutex unlocked by a thread that does not own it");
+			owner = -1;
+			s.wake_all(this);
+		}
+
+		// Releases without a scheduling point, for ConditionVariable::wait().
+		void release() {
+			Scheduler::current()->fence();
+			owner = -1;
+			Scheduler::current()->wake_all(this);
+		}
+	};
+
+	class ConditionVariable
+	{
+		std::deque<int> waiters;
+		std::vector<bool> notified;
+
+	public:
+		void wait(std::unique_lock<Mutex> &lock) {
+			Scheduler &s = *Scheduler::current();
+			int self = Scheduler::thread_id();
+			s.schedule_point();
+			if ((int)notified.size() <= self)
+				notified.resize(self + 1);
+			notified[self] = false;
+			waiters.push_back(self);
+			lock.mutex()->release();
+			while (!notified[self])
+				s.block(&notified);
+			lock.mutex()->lock();
+		}
+
+		// The deadline is not modelled: the wait may time out at any point after
+		// the waiter has let other threads run once.
+		template<class Clock, class Duration>
+		std::cv_status wait_until(std::unique_lock<Mutex> &lock, const std::chrono::time_point<Clock, Duration> &) {
+			Scheduler &s = *Scheduler::current();
+			int self = Scheduler::thread_id();
+			s.schedule_point();
+			if ((int)notified.size() <= self)
+				notified.resize(self + 1);
+			notified[self] = false;
+			waiters.push_back(self);
+			lock.mutex()->release();
+			s.schedule_point();
+			bool timedOut = !notified[self];
+			if (timedOut)
+				waiters.erase(std::find(waiters.begin(), waiters.end(), self));
+			lock.mutex()->lock();
+			return timedOut ? std::cv_status::timeout : std::cv_status::no_timeout;
+		}
+
+		template<class Predicate>
+		void wait(std::unique_lock<Mutex> &lock, Predicate predicate) {
+			while (!predicate())
+				wait(lock);
+		}
+
+		void notify_one() {
+			Scheduler &s = *Scheduler::current();
+			s.schedule_point();
+			s.fence();
+			if (waiters.empty())
+				return;
+			int t = waiters.front();
+			waiters.pop_front();
+			notified[t] = true;
+			s.wake_thread(t);
+		}
+
+		void notify_all() {
+			Scheduler &s = *Scheduler::current();
+			s.schedule_point();
+			s.fence();
+			for (int t : waiters) {
+				notified[t] = true;
+				s.wake_thread(t);
+			}
+			waiters.clear();
+		}
+	};
+
+	// Stores weaker than seq_cst are buffered (see the top of the file): each
+	// thread reads its own latest buffered store, others the committed value.
+	template<class T>
+	class Atomic
+	{
+		T value;
+		std::deque<std::pair<int, T>> buffered;   // (thread, value), oldest first
+
+		static void commit(void *object, int thread) {
+			Atomic &a = *static_cast<Atomic *>(object);
+			auto it = std::find_if(a.buffered.begin(), a.buffered.end(), [&](const std::pair<int, T> &b) { return b.first == thread; });
+			a.value = it->second;
+			a.buffered.erase(it);
+		}
+
+		T visible() const {
+			int self = Scheduler::thread_id();
+			for (auto it = buffered.rbegin(); it != buffered.rend(); ++it)
+				if (it->first == self)
+					return it->second;
+			return value;
+		}
+
+		// Read-modify-writes drain the caller's buffer first, as locked
+		// instructions do.
+		static Scheduler &rmw() {
+			Scheduler &s = *Scheduler::current();
+			s.schedule_point();
+			s.fence();
+			return s;
+		}
+
+	public:
+		Atomic(T value = T()) : value(value) {
+		}
+
+		Atomic(const Atomic &) = delete;
+		Atomic &operator=(const Atomic &) = delete;
+
+		T load(std::memory_order = std::memory_order_seq_cst) const {
+			Scheduler::current()->schedule_point();
+			return visible();
+		}
+
+		void store(T desired, std::memory_order order = std::memory_order_seq_cst) {
+			Scheduler &s = *Scheduler::current();
+			s.schedule_point();
+			if (order == std::memory_order_seq_cst || !s.buffers_stores()) {
+				s.fence();
+				value = desired;
+				return;
+			}
+			buffered.emplace_back(Scheduler::thread_id(), desired);
+			s.buffer_store(this, &Atomic::commit);
+		}
+
+		T exchange(T desired, std::memory_order = std::memory_order_seq_cst) {
+			rmw();
+			T old = value;
+			value = desired;
+			return old;
+		}
+
+		bool compare_exchange_strong(T &expected, T desired, std::memory_order = std::memory_order_seq_cst, std::memory_order = std::memory_order_seq_cst) {
+			rmw();
+			if (value != expected) {
+				expected = value;
+				return false;
+			}
+			value = desired;
+			return true;
+		}
+
+		T fetch_add(T n, std::memory_order = std::memory_order_seq_cst) {
+			rmw();
+			T old = value;
+			value += n;
+			return old;
+		}
+
+		T fetch_sub(T n, std::memory_order = std::memory_order_seq_cst) {
+			rmw();
+			T old = value;
+			value -= n;
+			return old;
+		}
+
+		void wait(T old, std::memory_order = std::memory_order_seq_cst) const {
+			Scheduler &s = *Scheduler::current();
+			s.schedule_point();
+			while (visible() == old)
+				s.block(this);
+		}
+
+		void notify_one() {
+			notify_all();
+		}
+
+		// A futex wake is a system call, which drains the store buffer.
+		void notify_all() {
+			Scheduler &s = *Scheduler::current();
+			s.schedule_point();
+			s.fence();
+			s.wake_all(this);
+		}
+	};
+}
@@ -0,0 +1,289 @@
+#pragma once
+#include "SharedMutex.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Reader/writer lock with priority inheritance, for real-time threads that
+// must not wait behind a preempted low-priority holder. Linux only.
+//
+// Every wait is on a PI futex, where the kernel queues waiters by priority
+// and lends the highest waiter's priority to the owner:
+// - Writers hold `gate` for their whole critical section.
+// - A reader that finds a writer queues on the gate too, so blocked readers
+//   and writers are admitted in priority order and boost the writer. Once
+//   through, it passes the gate on to the next waiter.
+// - A reader inside owns a slot futex; a writer waiting for readers to leave
+//   waits on their slots, boosting each in turn. Readers beyond nSlots, and
+//   nested shared locks taken while a writer waits, are counted without a
+//   slot and are not boosted. Each thread keeps its own count of those, so
+//   it can nest again and lock() can refuse it.
+//
+// Unlike SharedMutex, a lock must be released by the thread that acquired it,
+// and a thread must not exit while holding one. Boosting needs SCHED_FIFO or
+// SCHED_RR threads: the kernel orders all other threads' waits first come,
+// first served, whatever their nice value.
+class PriorityInheritanceSharedMutex
+{
+	static const int nSlots = 32;
+
+	struct alignas(64) Slot
+	{
+		std::atomic<std::uint32_t> owner{0};   // PI futex, tid of the reader inside
+	};
+
+	std::atomic<std::uint32_t> gate{0};           // PI futex, tid of the writer or of a reader passing through
+	Slot slots[nSlots];
+	std::atomic<std::uint32_t> slotlessReaders{0};  // plain futex, a writer waits for 0
+
+	static std::uint32_t tid() {
+		static thread_local std::uint32_t id = (std::uint32_t)syscall(SYS_gettid);
+		return id;
+	}
+
+	// Shared holds of this thread counted in slotlessReaders, per lock. Few
+	// locks at a time ever have one, so the list stays short.
+	struct SlotlessHold
+	{
+		const PriorityInheritanceSharedMutex *lock;
+		int depth;
+	};
+
+	static std::vector<SlotlessHold> &slotlessHolds() {
+		static thread_local std::vector<SlotlessHold> holds;
+		return holds;
+	}
+
+	int slotless_depth() const {
+		for (const SlotlessHold &hold : slotlessHolds())
+			if (hold.lock == this)
+				return hold.depth;
+		return 0;
+	}
+
+	void enter_slotless() {
+		std::vector<SlotlessHold> &holds = slotlessHolds();
+		auto it = std::find_if(holds.begin(), holds.end(), [&](const SlotlessHold &hold) { return hold.lock == this; });
+		if (it == holds.end())
+			holds.push_back(SlotlessHold{this, 1});
+		else
+			it->depth++;
+		slotlessReaders.fetch_add(1);
+	}
+
+	void leave_slotless() {
+		std::vector<SlotlessHold> &holds = slotlessHolds();
+		auto it = std::find_if(holds.begin(), holds.end(), [&](const SlotlessHold &hold) { return hold.lock == this; });
+		if (--it->depth == 0)
+			holds.erase(it);
+	}
+
+	static long futex(std::atomic<std::uint32_t> &word, int op, std::uint32_t value = 0) {
+		return syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), op, value, nullptr, nullptr, 0);
+	}
+
+	static bool try_lock_pi(std::atomic<std::uint32_t> &word) {
+		std::uint32_t expected = 0;
+		return word.compare_exchange_strong(expected, tid());
+	}
+
+	// Blocks in the kernel until the futex is handed to this thread.
+	static void lock_pi(std::atomic<std::uint32_t> &word) {
+		while (futex(word, FUTEX_LOCK_PI_PRIVATE) != 0) {
+			if (errno != EINTR && errno != EAGAIN)
+				throw std::system_error(errno, std::generic_category(), "FUTEX_LOCK_PI");
+		}
+	}
+
+	// The kernel hands a contended futex to its highest-priority waiter.
+	// released(woken) runs first, with the number of waiters woken, so a
+	// tracer sees the release before the waiter's wake.
+	template<class Released>
+	static void unlock_pi(std::atomic<std::uint32_t> &word, Released released) {
+		std::uint32_t expected = tid();
+		if (word.compare_exchange_strong(expected, 0)) {
+			released(0);
+			return;
+		}
+		released(1);
+		if (futex(word, FUTEX_UNLOCK_PI_PRIVATE) != 0)
+			throw std::system_error(errno, std::generic_category(), "FUTEX_UNLOCK_PI");
+	}
+
+	static void unlock_pi(std::atomic<std::uint32_t> &word) {
+		unlock_pi(word, [](int) {});
+	}
+
+	void lock_pi_traced(std::atomic<std::uint32_t> &word, bool exclusive) {
+		if (try_lock_pi(word))
+			return;
+		if (exclusive)
+			SHARED_MUTEX_TRACE_EVENT(contended_wait, exclusive, -1, -1);
+		else
+			SHARED_MUTEX_TRACE_EVENT(contended_wait, shared, -1, -1);
+		lock_pi(word);
+		if (exclusive)
+			SHARED_MUTEX_TRACE_EVENT(wake, exclusive, -1, -1);
+		else
+			SHARED_MUTEX_TRACE_EVENT(wake, shared, -1, -1);
+	}
+
+	// Takes a free slot, or counts the reader as slotless if all are taken.
+	Slot *enter() {
+		std::uint32_t self = tid();
+		for (int i = 0; i < nSlots; i++) {
+			Slot &slot = slots[(self + i) % nSlots];
+			std::uint32_t expected = 0;
+			if (slot.owner.load(std::memory_order_relaxed) == 0 && slot.owner.compare_exchange_strong(expected, self))
+				return &slot;
+		}
+		enter_slotless();
+		return nullptr;
+	}
+
+	// Emits the release, before any writer it wakes can run.
+	void leave(Slot *slot) {
+		if (slot) {
+			unlock_pi(slot->owner, [&]([[maybe_unused]] int woken) {
+				SHARED_MUTEX_TRACE_EVENT(release, shared, -1, -1, 0, woken);
+			});
+			return;
+		}
+		leave_slotless();
+		// a writer waiting for the count is not counted as woken: whether the
+		// wake reaches it is known only afterwards, and it rechecks the count
+		// itself
+		SHARED_MUTEX_TRACE_EVENT(release, shared, -1, -1, 0, 0);
+		if (slotlessReaders.fetch_sub(1) == 1 && gate.load() != 0)
+			futex(slotlessReaders, FUTEX_WAKE_PRIVATE, 1);
+	}
+
+	// Reader fast path: enter unless a writer holds or is taking the gate. The
+	// writer checks the slots after taking the gate, the reader checks the gate
+	// after taking a slot, so at least one sees the other.
+	bool try_enter() {
+		if (gate.load() != 0)
+			return false;
+		Slot *slot = enter();
+		if (gate.load() == 0)
+			return true;
+		leave(slot);
+		return false;
+	}
+
+	Slot *own_slot() {
+		std::uint32_t self = tid();
+		for (int i = 0; i < nSlots; i++) {
+			Slot &slot = slots[(self + i) % nSlots];
+			if ((slot.owner.load(std::memory_order_relaxed) & FUTEX_TID_MASK) == self)
+				return &slot;
+		}
+		return nullptr;
+	}
+
+public:
+	PriorityInheritanceSharedMutex() {
+	}
+
+	PriorityInheritanceSharedMutex(const PriorityInheritanceSharedMutex &) = delete;
+	PriorityInheritanceSharedMutex &operator=(const PriorityInheritanceSharedMutex &) = delete;
+
+	// Throws std::system_error (EDEADLK) if this thread already holds the lock
+	// exclusively or shared.
+	void lock() {
+		SHARED_MUTEX_TRACE_EVENT(acquire_start, exclusive, -1, -1);
+		// checked up front: behind another writer on the gate, this thread would
+		// wait for itself before the kernel could detect it
+		if (own_slot() || slotless_depth() > 0)
+			throw std::system_error(EDEADLK, std::generic_category(), "lock() while holding the lock shared");
+		lock_pi_traced(gate, true);
+		// no reader gets in any more; wait out the ones inside
+		try {
+			for (Slot &slot : slots) {
+				if (slot.owner.load() == 0)
+					continue;
+				lock_pi_traced(slot.owner, true);
+				unlock_pi(slot.owner);
+			}
+		}
+		catch (...) {
+			unlock_pi(gate);
+			throw;
+		}
+		for (std::uint32_t n; (n = slotlessReaders.load()) != 0;) {
+			SHARED_MUTEX_TRACE_EVENT(contended_wait, exclusive, -1, -1);
+			futex(slotlessReaders, FUTEX_WAIT_PRIVATE, n);
+			SHARED_MUTEX_TRACE_EVENT(wake, exclusive, -1, -1);
+		}
+		SHARED_MUTEX_TRACE_EVENT(acquire_granted, exclusive, -1, -1);
+	}
+
+	void shared_lock() {
+		SHARED_MUTEX_TRACE_EVENT(acquire_start, shared, -1, -1);
+		if (try_enter()) {
+			SHARED_MUTEX_TRACE_EVENT(acquire_granted, shared, -1, -1);
+			return;
+		}
+		if (own_slot() || slotless_depth() > 0) {
+			// already inside: queueing on the gate behind a writer that waits for
+			// this thread's slot or slotless count would deadlock. A new slot could
+			// be one the writer has already checked, but it reads the slotless
+			// count only after every slot it waits for is free.
+			enter_slotless();
+			SHARED_MUTEX_TRACE_EVENT(acquire_granted, shared, -1, -1);
+			return;
+		}
+		lock_pi_traced(gate, false);
+		// holding the gate, so no writer is inside
+		enter();
+		unlock_pi(gate, [&]([[maybe_unused]] int woken) {
+			SHARED_MUTEX_TRACE_EVENT(acquire_granted, shared, -1, -1, 0, woken);
+		});
+	}
+
+	bool try_lock() {
+		if (!try_lock_pi(gate))
+			return false;
+		bool readers = slotlessReaders.load() != 0;
+		for (Slot &slot : slots)
+			readers = readers || slot.owner.load() != 0;
+		if (readers) {
+			unlock_pi(gate, [&]([[maybe_unused]] int woken) {
+				SHARED_MUTEX_TRACE_EVENT(release, exclusive, -1, -1, 0, woken);
+			});
+			return false;
+		}
+		SHARED_MUTEX_TRACE_EVENT(acquire_granted, exclusive, -1, -1);
+		return true;
+	}
+
+	bool try_shared_lock() {
+		if (!try_enter())
+			return false;
+		SHARED_MUTEX_TRACE_EVENT(acquire_granted, shared, -1, -1);
+		return true;
+	}
+
+	void unlock() {
+		if ((gate.load() & FUTEX_TID_MASK) != tid())
+			throw std::logic_error("not locked");
+		unlock_pi(gate, [&]([[maybe_unused]] int woken) {
+			SHARED_MUTEX_TRACE_EVENT(release, exclusive, -1, -1, 0, woken);
+		});
+	}
+
+	void shared_unlock() {
+		// a nested hold counted without a slot is released before the slot
+		Slot *slot = slotless_depth() > 0 ? nullptr : own_slot();
+		if (!slot && slotless_depth() == 0)
+			throw std::logic_error("not locked");
+		leave(slot);
+	}
+};
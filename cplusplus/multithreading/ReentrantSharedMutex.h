@@ -0,0 +1,161 @@
+#pragma once
+#include "SharedMutex.h"
+#include <atomic>
+#include <stdexcept>
+
+// SharedMutex that the thread holding it may acquire again, for callbacks
+// that re-enter code taking the same lock:
+// - A thread holding it shared may take it shared again.
+// - The writer may take it exclusively or shared again.
+// Each acquisition needs its own release, innermost first. Only the outermost
+// acquisition and release reach the underlying SharedMutex, so a nested
+// acquisition never waits.
+//
+// A reader taking it exclusively (an upgrade) would wait for itself to leave,
+// and throws std::logic_error instead.
+//
+// The writer's depth is kept in the lock. A thread's shared depths are kept in
+// a small thread-local stack of the reentrant locks it holds, searched from the
+// most recently taken, which is the one a nested acquisition usually finds.
+class ReentrantSharedMutex
+{
+	struct Held
+	{
+		const ReentrantSharedMutex *lock;
+		int depth;
+		bool underWriter;   // first taken while this thread held it exclusively
+	};
+
+	struct HeldStack
+	{
+		static const int capacity = 16;
+		Held entries[capacity];
+		int size = 0;
+	};
+
+	SharedMutex m;
+	std::atomic<const HeldStack *> writer{nullptr};   // the writer's stack, identifying its thread
+	int writerDepth = 0;                              // touched by the writer only
+
+	// Also identifies the calling thread: only it stores its own stack in writer.
+	static HeldStack &held() {
+		static thread_local HeldStack stack;
+		return stack;
+	}
+
+	bool ownedByCaller() const {
+		return writer.load(std::memory_order_relaxed) == &held();
+	}
+
+	Held *find() const {
+		HeldStack &stack = held();
+		for (int i = stack.size - 1; i >= 0; i--)
+			if (stack.entries[i].lock == this)
+				return &stack.entries[i];
+		return nullptr;
+	}
+
+	// Throws before the lock is taken if the stack is full.
+	void reserve() const {
+		if (held().size == HeldStack::capacity)
+			throw std::length_error("too many ReentrantSharedMutex held by one thread");
+	}
+
+	void push(bool underWriter) {
+		HeldStack &stack = held();
+		stack.entries[stack.size++] = Held{this, 1, underWriter};
+	}
+
+	void erase(Held *entry) {
+		HeldStack &stack = held();
+		for (Held *next = entry + 1; next != stack.entries + stack.size; next++)
+			next[-1] = *next;
+		stack.size--;
+	}
+
+	void acquired() {
+		writer.store(&held(), std::memory_order_relaxed);
+		writerDepth = 1;
+	}
+
+public:
+	ReentrantSharedMutex() {
+	}
+
+	ReentrantSharedMutex(const ReentrantSharedMutex &) = delete;
+	ReentrantSharedMutex &operator=(const ReentrantSharedMutex &) = delete;
+
+	void lock() {
+		if (ownedByCaller()) {
+			writerDepth++;
+			return;
+		}
+		if (find())
+			throw std::logic_error("lock() would deadlock: calling thread holds this lock shared");
+		m.lock();
+		acquired();
+	}
+
+	void shared_lock() {
+		if (Held *entry = find()) {
+			entry->depth++;
+			return;
+		}
+		reserve();
+		bool underWriter = ownedByCaller();
+		if (!underWriter)
+			m.shared_lock();
+		push(underWriter);
+	}
+
+	bool try_lock() {
+		if (ownedByCaller()) {
+			writerDepth++;
+			return true;
+		}
+		// a reader's upgrade cannot succeed while it holds the lock itself
+		if (find() || !m.try_lock())
+			return false;
+		acquired();
+		return true;
+	}
+
+	bool try_shared_lock() {
+		if (Held *entry = find()) {
+			entry->depth++;
+			return true;
+		}
+		reserve();
+		bool underWriter = ownedByCaller();
+		if (!underWriter && !m.try_shared_lock())
+			return false;
+		push(underWriter);
+		return true;
+	}
+
+	void unlock() {
+		if (!ownedByCaller())
+			throw std::logic_error("not locked");
+		if (writerDepth > 1) {
+			writerDepth--;
+			return;
+		}
+		if (find())
+			throw std::logic_error("unlock() with a shared lock taken under it still held");
+		writerDepth = 0;
+		writer.store(nullptr, std::memory_order_relaxed);
+		m.unlock();
+	}
+
+	void shared_unlock() {
+		Held *entry = find();
+		if (!entry)
+			throw std::logic_error("not locked");
+		if (--entry->depth > 0)
+			return;
+		bool underWriter = entry->underWriter;
+		erase(entry);
+		if (!underWriter)
+			m.shared_unlock();
+	}
+};
@@ -1,45 +1,447 @@
 #pragma once
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <vector>
+#include "SharedMutexReaderCount.h"
+
+#if defined(SHARED_MUTEX_HISTOGRAMS) && !defined(SHARED_MUTEX_STATS)
+#define SHARED_MUTEX_STATS
+#endif
+
+#if defined(SHARED_MUTEX_STATS)
+#include "SharedMutexStats.h"
+#define SHARED_MUTEX_STAT(call) stats.call
+#else
+#define SHARED_MUTEX_STAT(call) ((void)0)
+#endif
+
+// Blocking acquisitions and releases take the caller's source location when
+// a debug mode reports sites.
+#if defined(SHARED_MUTEX_LOCKDEP) || defined(SHARED_MUTEX_CHECKED)
+#include "SharedMutexDebug.h"
+#define SHARED_MUTEX_DEBUG_HOOK(call) shared_mutex_debug::call
+#define SHARED_MUTEX_SITE [[maybe_unused]] std::source_location site = std::source_location::current()
+#define SHARED_MUTEX_TRAILING_SITE , SHARED_MUTEX_SITE
+#else
+#define SHARED_MUTEX_DEBUG_HOOK(call) ((void)0)
+#define SHARED_MUTEX_SITE
+#define SHARED_MUTEX_TRAILING_SITE
+#endif
+
+#if defined(SHARED_MUTEX_CHECKED)
+#define SHARED_MUTEX_OWNER_HOOK(call) owners.call
+#else
+#define SHARED_MUTEX_OWNER_HOOK(call) ((void)0)
+#endif
+
+#if defined(SHARED_MUTEX_TRACE)
+#include "SharedMutexTrace.h"
+#define SHARED_MUTEX_TRACE_EVENT(event, mode, ...) \
+	shared_mutex_trace::emit(shared_mutex_trace::Event::event, shared_mutex_trace::Mode::mode, this, __VA_ARGS__)
+#else
+#define SHARED_MUTEX_TRACE_EVENT(event, mode, ...) ((void)0)
+#endif
+
+#if defined(SHARED_MUTEX_SPIN)
+#include "SharedMutexSpin.h"
+#define SHARED_MUTEX_SPIN_HOOK(call) spin.call
+#else
+#define SHARED_MUTEX_SPIN_HOOK(call) ((void)0)
+#endif
+
+// Synchronization primitives, replaceable by a model checker's (see
+// ModelChecker.h). All three must be replaced together.
+#if !defined(SHARED_MUTEX_MUTEX)
+#define SHARED_MUTEX_MUTEX std::mutex
+#define SHARED_MUTEX_CONDITION_VARIABLE std::condition_variable
+#define SHARED_MUTEX_ATOMIC std::atomic
+#endif
 
 class SharedMutex
 {
-	std::mutex m;
-	std::condition_variable cond_var;
-	int nReaders = 0;
+	SHARED_MUTEX_MUTEX m;
+	SHARED_MUTEX_CONDITION_VARIABLE cond_var;   // blocked writers
+	SharedMutexReaderCount<> nReaders;
 	bool hasWriter = false;
+	int nWaitingWriters = 0;
+
+	// Blocked readers are admitted in one batch by the writer that releases the
+	// lock: it adds them all to nReaders and bumps readerPhase, and each reader
+	// returns from its wait already holding the lock, without retaking m.
+	int nWaitingReaders = 0;
+	SHARED_MUTEX_ATOMIC<unsigned> readerPhase{0};
+
+	// Readers in try_shared_lock_for() wait on their own condition variable
+	// instead, so they can give up, and take the lock themselves once woken.
+	SHARED_MUTEX_CONDITION_VARIABLE reader_cond_var;
+	int nTimedReaders = 0;
+
+	// Continuations queued by lock_then()/lock_shared_then(); each entry posts
+	// its callback to the executor it was registered with.
+	std::vector<std::function<void()>> pendingReaders;
+	std::vector<std::function<void()>> pendingWriters;
+
+#if defined(SHARED_MUTEX_STATS)
+	SharedMutexStats stats;
+#endif
+#if defined(SHARED_MUTEX_CHECKED)
+	shared_mutex_debug::Ownership owners;
+#endif
+#if defined(SHARED_MUTEX_SPIN)
+	SharedMutexSpin spin;
+#endif
+
+	// Called with m held after the lock state changed. Grants the lock to queued
+	// continuations: every pending reader at once, otherwise the first pending
+	// writer. Returns true if it granted a writer.
+	bool admitPending(std::vector<std::function<void()>> &admitted) {
+		if (hasWriter)
+			return false;
+		if (!pendingReaders.empty()) {
+			nReaders += pendingReaders.size();
+			SHARED_MUTEX_STAT(shared_acquired((int)pendingReaders.size(), nReaders, true));
+			SHARED_MUTEX_OWNER_HOOK(shared_granted((int)pendingReaders.size()));
+			admitted.swap(pendingReaders);
+		}
+		else if (nReaders == 0 && !pendingWriters.empty()) {
+			hasWriter = true;
+			SHARED_MUTEX_STAT(exclusive_acquired(0, true));
+			SHARED_MUTEX_OWNER_HOOK(exclusive_granted());
+			admitted.push_back(std::move(pendingWriters.front()));
+			pendingWriters.erase(pendingWriters.begin());
+			return true;
+		}
+		return false;
+	}
+
+	// Called with m held after a release: wakes one blocked writer if it can now
+	// enter. Returns the number of writers woken.
+	int notifyWriter() {
+		if (hasWriter || nReaders > 0 || nWaitingWriters == 0)
+			return 0;
+		cond_var.notify_one();
+		return 1;
+	}
+
+	// Called with m held before a reader enters or queues. Queued readers are
+	// admitted later without a chance to refuse, so they count as inside.
+	void check_readers() const {
+		nReaders.check((std::uint64_t)nWaitingReaders + nTimedReaders + pendingReaders.size() + 1);
+	}
+
+	// Posts continuations granted the lock, without m. A continuation whose
+	// post() throws gives its grant back, so the lock is not held forever by
+	// a callback that will never run, and the rest are still posted; the
+	// first exception is rethrown afterwards.
+	void dispatch(std::vector<std::function<void()>> &admitted, bool exclusive) {
+		std::exception_ptr failed;
+		for (auto &post : admitted) {
+			try {
+				post();
+			}
+			catch (...) {
+				if (!failed)
+					failed = std::current_exception();
+				revoke(exclusive);
+			}
+		}
+		if (failed)
+			std::rethrow_exception(failed);
+	}
+
+	// Releases a grant whose continuation could not be posted. The release may
+	// admit further continuations; any failure among them is undone the same
+	// way, and only the first exception of the outer batch is reported.
+	void revoke(bool exclusive) {
+		try {
+			if (exclusive)
+				unlock();
+			else
+				shared_unlock();
+		}
+		catch (...) {
+		}
+	}
+
 public:
 	SharedMutex() {
 	}
 
-	void lock() {
-		std::unique_lock<std::mutex> lock(m);
-		while (hasWriter || nReaders > 0)
+	// The name identifies the instance in contention statistics.
+	explicit SharedMutex(const char *name)
+#if defined(SHARED_MUTEX_STATS)
+		: stats(name)
+#endif
+	{
+		(void)name;
+	}
+
+#if defined(SHARED_MUTEX_LOCKDEP) || defined(SHARED_MUTEX_CHECKED)
+	~SharedMutex() {
+		shared_mutex_debug::destroyed(this, hasWriter, nReaders);
+	}
+#endif
+
+#if defined(SHARED_MUTEX_STATS)
+	const SharedMutexStats &statistics() const {
+		return stats;
+	}
+#endif
+
+	void lock(SHARED_MUTEX_SITE) {
+		SHARED_MUTEX_DEBUG_HOOK(before_acquire(this, shared_mutex_debug::Mode::exclusive, site));
+		std::unique_lock<SHARED_MUTEX_MUTEX> lock(m);
+		SHARED_MUTEX_TRACE_EVENT(acquire_start, exclusive, nWaitingReaders, nWaitingWriters);
+#if defined(SHARED_MUTEX_STATS)
+		std::uint64_t waitStart = (hasWriter || nReaders > 0) ? shared_mutex_stats::now() : 0;
+#endif
+#if defined(SHARED_MUTEX_SPIN)
+		while (hasWriter && spin.spin(lock))
+			;
+#endif
+		while (hasWriter || nReaders > 0) {
+			nWaitingWriters++;
+			SHARED_MUTEX_TRACE_EVENT(contended_wait, exclusive, nWaitingReaders, nWaitingWriters);
 			cond_var.wait(lock);
+			nWaitingWriters--;
+			SHARED_MUTEX_TRACE_EVENT(wake, exclusive, nWaitingReaders, nWaitingWriters);
+		}
 		hasWriter = true;
+		SHARED_MUTEX_SPIN_HOOK(owner_acquired());
+		SHARED_MUTEX_TRACE_EVENT(acquire_granted, exclusive, nWaitingReaders, nWaitingWriters);
+		SHARED_MUTEX_STAT(exclusive_acquired(waitStart, waitStart != 0));
+		SHARED_MUTEX_OWNER_HOOK(exclusive_acquired(site));
+		SHARED_MUTEX_DEBUG_HOOK(after_acquire(this, shared_mutex_debug::Mode::exclusive, site));
 	}
 
-	void shared_lock() {
-		std::unique_lock<std::mutex> lock(m);
-		while(hasWriter)
-			cond_var.wait(lock);
+	void shared_lock(SHARED_MUTEX_SITE) {
+		SHARED_MUTEX_DEBUG_HOOK(before_acquire(this, shared_mutex_debug::Mode::shared, site));
+		std::unique_lock<SHARED_MUTEX_MUTEX> lock(m);
+		SHARED_MUTEX_TRACE_EVENT(acquire_start, shared, nWaitingReaders, nWaitingWriters);
+#if defined(SHARED_MUTEX_SPIN)
+		while (hasWriter && spin.spin(lock))
+			;
+#endif
+		check_readers();
+		if (!hasWriter) {
+			nReaders++;
+			SHARED_MUTEX_TRACE_EVENT(acquire_granted, shared, nWaitingReaders, nWaitingWriters);
+			SHARED_MUTEX_STAT(shared_acquired(1, nReaders, false));
+			SHARED_MUTEX_STAT(shared_entered());
+			SHARED_MUTEX_OWNER_HOOK(shared_acquired());
+			SHARED_MUTEX_DEBUG_HOOK(after_acquire(this, shared_mutex_debug::Mode::shared, site));
+			return;
+		}
+		nWaitingReaders++;
+		SHARED_MUTEX_OWNER_HOOK(shared_waiting());
+		SHARED_MUTEX_TRACE_EVENT(contended_wait, shared, nWaitingReaders, nWaitingWriters);
+#if defined(SHARED_MUTEX_STATS)
+		std::uint64_t waitStart = shared_mutex_stats::now();
+#endif
+		unsigned phase = readerPhase.load(std::memory_order_relaxed);
+		lock.unlock();
+		readerPhase.wait(phase, std::memory_order_acquire);
+		SHARED_MUTEX_TRACE_EVENT(wake, shared, -1, -1);
+		SHARED_MUTEX_TRACE_EVENT(acquire_granted, shared, -1, -1);
+		SHARED_MUTEX_STAT(shared_waited(waitStart));
+		SHARED_MUTEX_DEBUG_HOOK(after_acquire(this, shared_mutex_debug::Mode::shared, site));
+	}
+
+	bool try_lock(SHARED_MUTEX_SITE) {
+		std::unique_lock<SHARED_MUTEX_MUTEX> lock(m);
+		if (hasWriter || nReaders > 0)
+			return false;
+		hasWriter = true;
+		SHARED_MUTEX_SPIN_HOOK(owner_acquired());
+		SHARED_MUTEX_TRACE_EVENT(acquire_granted, exclusive, nWaitingReaders, nWaitingWriters);
+		SHARED_MUTEX_STAT(exclusive_acquired(0, false));
+		SHARED_MUTEX_OWNER_HOOK(exclusive_acquired(site));
+		SHARED_MUTEX_DEBUG_HOOK(after_acquire(this, shared_mutex_debug::Mode::exclusive, site));
+		return true;
+	}
+
+	bool try_shared_lock(SHARED_MUTEX_SITE) {
+		std::unique_lock<SHARED_MUTEX_MUTEX> lock(m);
+		if (hasWriter)
+			return false;
+		check_readers();
+		nReaders++;
+		SHARED_MUTEX_TRACE_EVENT(acquire_granted, shared, nWaitingReaders, nWaitingWriters);
+		SHARED_MUTEX_STAT(shared_acquired(1, nReaders, false));
+		SHARED_MUTEX_STAT(shared_entered());
+		SHARED_MUTEX_OWNER_HOOK(shared_acquired());
+		SHARED_MUTEX_DEBUG_HOOK(after_acquire(this, shared_mutex_debug::Mode::shared, site));
+		return true;
+	}
+
+	// Like lock(), but gives up and returns false once timeout has passed.
+	template<class Rep, class Period>
+	bool try_lock_for(const std::chrono::duration<Rep, Period> &timeout SHARED_MUTEX_TRAILING_SITE) {
+		SHARED_MUTEX_DEBUG_HOOK(before_acquire(this, shared_mutex_debug::Mode::exclusive, site));
+		auto deadline = std::chrono::steady_clock::now() + timeout;
+		std::unique_lock<SHARED_MUTEX_MUTEX> lock(m);
+		SHARED_MUTEX_TRACE_EVENT(acquire_start, exclusive, nWaitingReaders, nWaitingWriters);
+#if defined(SHARED_MUTEX_STATS)
+		std::uint64_t waitStart = (hasWriter || nReaders > 0) ? shared_mutex_stats::now() : 0;
+#endif
+		while (hasWriter || nReaders > 0) {
+			nWaitingWriters++;
+			SHARED_MUTEX_TRACE_EVENT(contended_wait, exclusive, nWaitingReaders, nWaitingWriters);
+			bool timedOut = cond_var.wait_until(lock, deadline) == std::cv_status::timeout;
+			nWaitingWriters--;
+			SHARED_MUTEX_TRACE_EVENT(wake, exclusive, nWaitingReaders, nWaitingWriters);
+			if (timedOut && (hasWriter || nReaders > 0))
+				return false;
+		}
+		hasWriter = true;
+		SHARED_MUTEX_SPIN_HOOK(owner_acquired());
+		SHARED_MUTEX_TRACE_EVENT(acquire_granted, exclusive, nWaitingReaders, nWaitingWriters);
+		SHARED_MUTEX_STAT(exclusive_acquired(waitStart, waitStart != 0));
+		SHARED_MUTEX_OWNER_HOOK(exclusive_acquired(site));
+		SHARED_MUTEX_DEBUG_HOOK(after_acquire(this, shared_mutex_debug::Mode::exclusive, site));
+		return true;
+	}
+
+	// Like shared_lock(), but gives up and returns false once timeout has passed.
+	template<class Rep, class Period>
+	bool try_shared_lock_for(const std::chrono::duration<Rep, Period> &timeout SHARED_MUTEX_TRAILING_SITE) {
+		SHARED_MUTEX_DEBUG_HOOK(before_acquire(this, shared_mutex_debug::Mode::shared, site));
+		auto deadline = std::chrono::steady_clock::now() + timeout;
+		std::unique_lock<SHARED_MUTEX_MUTEX> lock(m);
+		SHARED_MUTEX_TRACE_EVENT(acquire_start, shared, nWaitingReaders, nWaitingWriters);
+#if defined(SHARED_MUTEX_STATS)
+		std::uint64_t waitStart = hasWriter ? shared_mutex_stats::now() : 0;
+#endif
+		check_readers();
+		while (hasWriter) {
+			nTimedReaders++;
+			SHARED_MUTEX_TRACE_EVENT(contended_wait, shared, nWaitingReaders + nTimedReaders, nWaitingWriters);
+			bool timedOut = reader_cond_var.wait_until(lock, deadline) == std::cv_status::timeout;
+			nTimedReaders--;
+			SHARED_MUTEX_TRACE_EVENT(wake, shared, nWaitingReaders + nTimedReaders, nWaitingWriters);
+			if (timedOut && hasWriter)
+				return false;
+		}
 		nReaders++;
+		SHARED_MUTEX_TRACE_EVENT(acquire_granted, shared, nWaitingReaders, nWaitingWriters);
+		SHARED_MUTEX_STAT(shared_acquired(1, nReaders, waitStart != 0));
+#if defined(SHARED_MUTEX_STATS)
+		if (waitStart)
+			stats.shared_waited(waitStart);
+		else
+			stats.shared_entered();
+#endif
+		SHARED_MUTEX_OWNER_HOOK(shared_acquired());
+		SHARED_MUTEX_DEBUG_HOOK(after_acquire(this, shared_mutex_debug::Mode::shared, site));
+		return true;
 	}
 
-	void unlock() {
-		std::unique_lock<std::mutex> lock(m);
-		if (!hasWriter)
-			throw std::logic_error("not locked");
-		hasWriter = false;
-		cond_var.notify_all();
+	// Non-blocking acquisition for event loops: callback is posted to executor
+	// once the lock is granted and runs holding it, so it must release the lock
+	// with unlock()/shared_unlock(). Executor is any type with post(f) that
+	// outlives the wait. Readers admitted together are dispatched in one pass.
+	// If post() throws, that grant is released again and the exception
+	// propagates, from lock_then() itself or from the unlock()/shared_unlock()
+	// that admitted the continuation, once the rest of its batch is posted.
+	template<class Callback, class Executor>
+	void lock_then(Callback callback, Executor &executor) {
+		std::function<void()> post = [callback = std::move(callback), &executor]() mutable {
+			executor.post(std::move(callback));
+		};
+		{
+			std::unique_lock<SHARED_MUTEX_MUTEX> lock(m);
+			if (hasWriter || nReaders > 0) {
+				pendingWriters.push_back(std::move(post));
+				return;
+			}
+			hasWriter = true;
+			SHARED_MUTEX_STAT(exclusive_acquired(0, false));
+			SHARED_MUTEX_OWNER_HOOK(exclusive_granted());
+		}
+		std::vector<std::function<void()>> admitted;
+		admitted.push_back(std::move(post));
+		dispatch(admitted, true);
 	}
 
-	void shared_unlock() {
-		std::unique_lock<std::mutex> lock(m);
-		if (nReaders == 0)
-			throw std::logic_error("not locked");
-		nReaders--;
-		cond_var.notify_all();
+	template<class Callback, class Executor>
+	void lock_shared_then(Callback callback, Executor &executor) {
+		std::function<void()> post = [callback = std::move(callback), &executor]() mutable {
+			executor.post(std::move(callback));
+		};
+		{
+			std::unique_lock<SHARED_MUTEX_MUTEX> lock(m);
+			check_readers();
+			if (hasWriter) {
+				pendingReaders.push_back(std::move(post));
+				return;
+			}
+			nReaders++;
+			SHARED_MUTEX_STAT(shared_acquired(1, nReaders, false));
+			SHARED_MUTEX_OWNER_HOOK(shared_granted(1));
+		}
+		std::vector<std::function<void()>> admitted;
+		admitted.push_back(std::move(post));
+		dispatch(admitted, false);
 	}
 
+	void unlock(SHARED_MUTEX_SITE) {
+		std::vector<std::function<void()>> admitted;
+		bool admittedWriter = false;
+		{
+			std::unique_lock<SHARED_MUTEX_MUTEX> lock(m);
+			SHARED_MUTEX_OWNER_HOOK(check_unlock(this, hasWriter, site));
+			if (!hasWriter)
+				throw std::logic_error("not locked");
+			hasWriter = false;
+			SHARED_MUTEX_SPIN_HOOK(owner_released());
+			SHARED_MUTEX_STAT(exclusive_released());
+			SHARED_MUTEX_OWNER_HOOK(exclusive_released());
+			SHARED_MUTEX_DEBUG_HOOK(after_release(this));
+			[[maybe_unused]] int wokenReaders = nWaitingReaders + nTimedReaders;
+			bool admitWaiting = nWaitingReaders > 0;
+			if (admitWaiting) {
+				nReaders += nWaitingReaders;
+				SHARED_MUTEX_STAT(shared_acquired(nWaitingReaders, nReaders, true));
+				SHARED_MUTEX_OWNER_HOOK(waiting_admitted());
+				nWaitingReaders = 0;
+			}
+			if (nTimedReaders > 0)
+				reader_cond_var.notify_all();
+			admittedWriter = admitPending(admitted);
+			[[maybe_unused]] int wokenWriters = notifyWriter();
+			// before the admitted readers are woken: they run on without m, and
+			// a tracer must see the release ahead of their wake events
+			SHARED_MUTEX_TRACE_EVENT(release, exclusive, nWaitingReaders, nWaitingWriters, wokenReaders, wokenWriters);
+			if (admitWaiting) {
+				// notified under m: an admitted reader cannot release the lock and
+				// destroy the mutex until this unlock() has left m
+				readerPhase.fetch_add(1, std::memory_order_release);
+				readerPhase.notify_all();
+			}
+		}
+		dispatch(admitted, admittedWriter);
+	}
+
+	void shared_unlock(SHARED_MUTEX_SITE) {
+		std::vector<std::function<void()>> admitted;
+		bool admittedWriter = false;
+		{
+			std::unique_lock<SHARED_MUTEX_MUTEX> lock(m);
+			SHARED_MUTEX_OWNER_HOOK(check_shared_unlock(this, nReaders, site));
+			if (nReaders == 0)
+				throw std::logic_error("not locked");
+			nReaders--;
+			SHARED_MUTEX_STAT(shared_released(nReaders));
+			SHARED_MUTEX_OWNER_HOOK(shared_released());
+			SHARED_MUTEX_DEBUG_HOOK(after_release(this));
+			admittedWriter = admitPending(admitted);
+			[[maybe_unused]] int wokenWriters = notifyWriter();
+			SHARED_MUTEX_TRACE_EVENT(release, shared, nWaitingReaders, nWaitingWriters, 0, wokenWriters);
+		}
+		dispatch(admitted, admittedWriter);
+	}
 };
@@ -0,0 +1,314 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <source_location>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Debug-build diagnostics for SharedMutex.
+//
+// SHARED_MUTEX_LOCKDEP tracks, per thread, which SharedMutex instances are held
+// and in which mode, and builds a process-wide lock-order graph: acquiring B
+// while holding A adds the edge A -> B. An edge that closes a cycle means two
+// code paths take the same locks in opposite orders, which can deadlock; it is
+// reported once, with the acquisition sites of every edge on the cycle.
+// Acquiring a lock the calling thread already holds in a conflicting mode
+// would hang forever and throws std::logic_error instead.
+//
+// Tracking assumes a lock is released by the thread that acquired it.
+//
+// SHARED_MUTEX_CHECKED enforces that assumption: each SharedMutex records the
+// thread that holds it exclusively and how many shared holds each thread has.
+// Releasing a lock the calling thread does not hold, including a double
+// unlock, throws std::logic_error naming the release site and, where known,
+// the acquisition site. A thread that exits, or a SharedMutex destroyed, while
+// still locked is reported through the report handler. Locks granted to
+// lock_then()/lock_shared_then() continuations have no owning thread and may
+// be released by any thread. The conflicting-mode self-deadlock check above
+// is active in this mode too.
+//
+// Both macros must be defined the same way in every translation unit.
+
+namespace shared_mutex_debug
+{
+	enum class Mode { shared, exclusive };
+
+	struct Held
+	{
+		const void *lock;
+		Mode mode;
+		std::source_location site;
+	};
+
+	inline std::string describe(const void *lock, const std::source_location &site) {
+		char buffer[512];
+		std::snprintf(buffer, sizeof buffer, "%p acquired at %s:%u (%s)",
+			lock, site.file_name(), (unsigned)site.line(), site.function_name());
+		return buffer;
+	}
+
+	inline std::function<void(const std::string &)> &reportHandler() {
+		static std::function<void(const std::string &)> handler = [](const std::string &report) {
+			std::fputs(report.c_str(), stderr);
+		};
+		return handler;
+	}
+
+	// Replaces the default handler, which prints reports to stderr.
+	inline void set_report_handler(std::function<void(const std::string &)> handler) {
+		reportHandler() = std::move(handler);
+	}
+
+	inline void report(const std::string &message) {
+		reportHandler()(message);
+	}
+
+	inline std::string describe(const std::source_location &site) {
+		return std::string(site.file_name()) + ":" + std::to_string(site.line()) + " (" + site.function_name() + ")";
+	}
+
+	inline std::string describe(const Held &held) {
+		return describe(held.lock, held.site) + (held.mode == Mode::exclusive ? " exclusively" : " shared");
+	}
+
+	struct HeldLocks
+	{
+		std::vector<Held> held;
+
+#if defined(SHARED_MUTEX_CHECKED)
+		~HeldLocks() {
+			for (const Held &h : held)
+				report("SharedMutex checked: thread exited holding " + describe(h) + "\n");
+		}
+#endif
+	};
+
+	inline std::vector<Held> &heldLocks() {
+		static thread_local HeldLocks locks;
+		return locks.held;
+	}
+
+	inline Held *findHeld(const void *lock) {
+		std::vector<Held> &held = heldLocks();
+		for (auto it = held.rbegin(); it != held.rend(); ++it)
+			if (it->lock == lock)
+				return &*it;
+		return nullptr;
+	}
+
+	inline void pushHeld(const void *lock, Mode mode, const std::source_location &site) {
+		heldLocks().push_back(Held{lock, mode, site});
+	}
+
+	// Returns false if the calling thread does not hold the lock.
+	inline bool popHeld(const void *lock) {
+		std::vector<Held> &held = heldLocks();
+		for (auto it = held.rbegin(); it != held.rend(); ++it) {
+			if (it->lock == lock) {
+				held.erase(std::next(it).base());
+				return true;
+			}
+		}
+		return false;
+	}
+
+	class LockOrderGraph
+	{
+		struct Edge
+		{
+			std::source_location fromSite;
+			std::source_location toSite;
+		};
+
+		std::mutex m;
+		std::unordered_map<const void *, std::unordered_map<const void *, Edge>> edges;
+
+		// Depth-first search for a path from -> to; on success path holds the
+		// visited nodes from `from` up to, not including, `to`.
+		bool findPath(const void *from, const void *to, std::vector<const void *> &path, std::unordered_map<const void *, bool> &visited) {
+			if (from == to)
+				return true;
+			if (visited[from])
+				return false;
+			visited[from] = true;
+			path.push_back(from);
+			auto it = edges.find(from);
+			if (it != edges.end())
+				for (auto &next : it->second)
+					if (findPath(next.first, to, path, visited))
+						return true;
+			path.pop_back();
+			return false;
+		}
+
+	public:
+		// Records held -> acquired for every lock the thread holds and returns
+		// a report if one of the new edges closes a cycle, or an empty string.
+		std::string add(const std::vector<Held> &held, const void *lock, const std::source_location &site) {
+			std::string reportText;
+			std::unique_lock<std::mutex> guard(m);
+			for (const Held &h : held) {
+				if (h.lock == lock)
+					continue;
+				auto &out = edges[h.lock];
+				if (out.count(lock))
+					continue;
+				out.emplace(lock, Edge{h.site, site});
+
+				std::vector<const void *> path;
+				std::unordered_map<const void *, bool> visited;
+				if (!findPath(lock, h.lock, path, visited))
+					continue;
+				path.push_back(h.lock);
+				reportText += "SharedMutex lockdep: lock order cycle, possible deadlock\n";
+				reportText += "  new edge: " + describe(h.lock, h.site) + "\n         -> " + describe(lock, site) + "\n";
+				reportText += "  existing order:\n";
+				for (std::size_t i = 0; i + 1 < path.size(); i++) {
+					const Edge &e = edges[path[i]][path[i + 1]];
+					reportText += "    " + describe(path[i], e.fromSite) + "\n      -> " + describe(path[i + 1], e.toSite) + "\n";
+				}
+			}
+			return reportText;
+		}
+
+		void forget(const void *lock) {
+			std::unique_lock<std::mutex> guard(m);
+			edges.erase(lock);
+			for (auto &out : edges)
+				out.second.erase(lock);
+		}
+	};
+
+	inline LockOrderGraph &lockOrderGraph() {
+		// never destroyed, so mutexes with static storage can be forgotten at exit
+		static LockOrderGraph *graph = new LockOrderGraph;
+		return *graph;
+	}
+
+#if defined(SHARED_MUTEX_CHECKED)
+	// Owner bookkeeping kept in each SharedMutex and guarded by its m.
+	class Ownership
+	{
+		std::thread::id writer;
+		std::source_location writerSite;
+		bool anonymousWriter = false;
+		std::unordered_map<std::thread::id, int> readers;
+		int anonymousReaders = 0;
+		std::vector<std::thread::id> waitingReaders;
+
+		static std::string misuse(const char *call, const std::source_location &site, const std::string &what) {
+			return std::string("SharedMutex checked: ") + call + " at " + describe(site) + ": " + what;
+		}
+
+	public:
+		void exclusive_acquired(const std::source_location &site) {
+			writer = std::this_thread::get_id();
+			writerSite = site;
+		}
+
+		// Granted to a continuation: released by whichever thread runs it.
+		void exclusive_granted() {
+			anonymousWriter = true;
+		}
+
+		void check_unlock(const void *lock, bool hasWriter, const std::source_location &site) {
+			if (!hasWriter)
+				throw std::logic_error(misuse("unlock()", site, "not locked (double unlock?)"));
+			if (!anonymousWriter && writer != std::this_thread::get_id())
+				throw std::logic_error(misuse("unlock()", site, "calling thread does not own the lock, " + describe(lock, writerSite) + " by another thread"));
+		}
+
+		void exclusive_released() {
+			writer = std::thread::id();
+			anonymousWriter = false;
+		}
+
+		void shared_acquired() {
+			readers[std::this_thread::get_id()]++;
+		}
+
+		void shared_waiting() {
+			waitingReaders.push_back(std::this_thread::get_id());
+		}
+
+		void waiting_admitted() {
+			for (std::thread::id id : waitingReaders)
+				readers[id]++;
+			waitingReaders.clear();
+		}
+
+		void shared_granted(int n) {
+			anonymousReaders += n;
+		}
+
+		void check_shared_unlock(const void *lock, std::uint64_t nReaders, const std::source_location &site) {
+			if (nReaders == 0)
+				throw std::logic_error(misuse("shared_unlock()", site, "not locked (double unlock?)"));
+			if (readers.count(std::this_thread::get_id()) == 0 && anonymousReaders == 0) {
+				char buffer[32];
+				std::snprintf(buffer, sizeof buffer, "%p", lock);
+				throw std::logic_error(misuse("shared_unlock()", site, std::string("calling thread holds no shared lock on ") + buffer));
+			}
+		}
+
+		void shared_released() {
+			auto it = readers.find(std::this_thread::get_id());
+			if (it == readers.end()) {
+				anonymousReaders--;
+				return;
+			}
+			if (--it->second == 0)
+				readers.erase(it);
+		}
+	};
+#endif
+
+	// Called before a blocking acquisition. Throws if the calling thread would
+	// wait for itself, otherwise records lock-order edges.
+	inline void before_acquire(const void *lock, Mode mode, const std::source_location &site) {
+		if (const Held *held = findHeld(lock)) {
+			if (held->mode == Mode::exclusive || mode == Mode::exclusive) {
+				throw std::logic_error(std::string(mode == Mode::exclusive ? "lock()" : "shared_lock()") +
+					" would deadlock: calling thread already holds this SharedMutex " +
+					(held->mode == Mode::exclusive ? "exclusively" : "shared") + ", " + describe(lock, held->site));
+			}
+		}
+#if defined(SHARED_MUTEX_LOCKDEP)
+		std::string cycle = lockOrderGraph().add(heldLocks(), lock, site);
+		if (!cycle.empty())
+			report(cycle);
+#else
+		(void)site;
+#endif
+	}
+
+	inline void after_acquire(const void *lock, Mode mode, const std::source_location &site) {
+		pushHeld(lock, mode, site);
+	}
+
+	inline void after_release(const void *lock) {
+		popHeld(lock);
+	}
+
+	inline void destroyed(const void *lock, bool hasWriter, std::uint64_t nReaders) {
+#if defined(SHARED_MUTEX_LOCKDEP)
+		lockOrderGraph().forget(lock);
+#endif
+#if defined(SHARED_MUTEX_CHECKED)
+		if (hasWriter || nReaders > 0) {
+			char buffer[128];
+			std::snprintf(buffer, sizeof buffer, "SharedMutex checked: %p destroyed while locked (%s)\n",
+				lock, hasWriter ? "exclusive" : "shared");
+			report(buffer);
+		}
+#else
+		(void)hasWriter;
+		(void)nReaders;
+#endif
+	}
+}
@@ -0,0 +1,312 @@
+#pragma once
+#include "SharedMutexTrace.h"
+#include "SharedMutexStats.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+// Always-on lock history for SharedMutex, built on the SHARED_MUTEX_TRACE
+// tracepoints.
+//
+//   shared_mutex_trace::flightRecorder().start();
+//   ...
+//   // on a latency spike, e.g. from a watchdog thread or an admin endpoint:
+//   shared_mutex_trace::flightRecorder().write_chrome_trace(file, std::chrono::seconds(5));
+//
+// Every thread records into its own fixed-size ring, so recording is a TSC
+// read and a few relaxed stores with no shared cache lines; the oldest events
+// are overwritten. Rings outlive their threads and are reused by new ones, so
+// the history of a thread that has exited is still available.
+//
+// write_chrome_trace() writes the Chrome trace event format, which loads in
+// chrome://tracing and ui.perfetto.dev: one track per thread with a slice for
+// each contended wait and each hold, and instant events for releases the
+// thread did not acquire itself or whose acquisition has been overwritten.
+namespace shared_mutex_trace
+{
+	class FlightRecorder
+	{
+	public:
+		using Clock = std::uint64_t (*)();
+
+	private:
+		struct Slot
+		{
+			std::atomic<std::uint64_t> time{0};
+			std::atomic<std::uintptr_t> lock{0};
+			std::atomic<std::uint64_t> kind{0};     // event | mode << 4 | thread << 32
+			std::atomic<std::uint64_t> counts{0};   // 4 x 16 bits, see pack()
+		};
+
+		struct Ring
+		{
+			std::unique_ptr<Slot[]> slots;
+			std::size_t capacity;
+			std::atomic<std::uint64_t> head{0};      // events published
+			std::atomic<std::uint64_t> started{0};   // events whose slot stores have begun
+			std::atomic<std::uint64_t> cleared{0};   // events before this one are not exported
+			std::atomic<bool> inUse{true};
+
+			explicit Ring(std::size_t capacity) : slots(new Slot[capacity]), capacity(capacity) {
+			}
+		};
+
+		struct RingOwner
+		{
+			Ring *ring = nullptr;
+			std::uint32_t thread = 0;
+
+			~RingOwner() {
+				if (ring)
+					ring->inUse.store(false, std::memory_order_release);
+			}
+		};
+
+		struct Decoded
+		{
+			std::uint64_t time;
+			const void *lock;
+			Event event;
+			Mode mode;
+			std::uint32_t thread;
+			int waitingReaders;
+			int waitingWriters;
+			int wokenReaders;
+			int wokenWriters;
+		};
+
+		std::mutex m;                 // guards rings; never taken when recording
+		std::vector<Ring *> rings;    // never freed
+		std::atomic<std::size_t> eventsPerThread{1 << 14};
+		std::atomic<std::uint32_t> nextThread{1};
+		std::atomic<Clock> clock{nullptr};           // nullptr: shared_mutex_stats::now()
+		std::atomic<double> clockTicksPerNanosecond{0};
+
+		static std::uint64_t pack(int value, int shift) {
+			return (std::uint64_t)(value < 0 ? 0xffff : std::min(value, 0xfffe)) << shift;
+		}
+
+		static int unpack(std::uint64_t counts, int shift) {
+			int value = (int)((counts >> shift) & 0xffff);
+			return value == 0xffff ? -1 : value;
+		}
+
+		RingOwner &owner() {
+			static thread_local RingOwner owner;
+			if (!owner.ring) {
+				owner.thread = nextThread.fetch_add(1, std::memory_order_relaxed);
+				std::unique_lock<std::mutex> lock(m);
+				std::size_t capacity = eventsPerThread.load(std::memory_order_relaxed);
+				for (Ring *ring : rings) {
+					bool expected = false;
+					if (ring->capacity == capacity && ring->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+						owner.ring = ring;
+						return owner;
+					}
+				}
+				owner.ring = new Ring(capacity);
+				rings.push_back(owner.ring);
+			}
+			return owner;
+		}
+
+		static void trace(const Record &record);
+
+		void record(const Record &record) {
+			RingOwner &o = owner();
+			Ring &ring = *o.ring;
+			std::uint64_t h = ring.head.load(std::memory_order_relaxed);
+			Slot &slot = ring.slots[h % ring.capacity];
+			// announces that slot h - capacity is being overwritten, ordered before
+			// the slot stores as in a seqlock
+			ring.started.store(h + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			Clock now = clock.load(std::memory_order_relaxed);
+			slot.time.store(now ? now() : shared_mutex_stats::now(), std::memory_order_relaxed);
+			slot.lock.store((std::uintptr_t)record.lock, std::memory_order_relaxed);
+			slot.kind.store((std::uint64_t)record.event | (std::uint64_t)record.mode << 4 | (std::uint64_t)o.thread << 32, std::memory_order_relaxed);
+			slot.counts.store(pack(record.waitingReaders, 0) | pack(record.waitingWriters, 16) |
+				pack(record.wokenReaders, 32) | pack(record.wokenWriters, 48), std::memory_order_relaxed);
+			ring.head.store(h + 1, std::memory_order_release);
+		}
+
+		// Copies one ring, dropping slots the owner overwrote while it was read.
+		// Having seen any of a slot's stores, the reader also sees the started
+		// count that announced them, so slots below started - capacity may be
+		// torn.
+		static void copy(const Ring &ring, std::vector<Decoded> &out) {
+			std::uint64_t end = ring.head.load(std::memory_order_acquire);
+			std::uint64_t begin = std::max(end > ring.capacity ? end - ring.capacity : 0, ring.cleared.load(std::memory_order_relaxed));
+			if (begin > end)
+				return;
+			std::vector<Decoded> copied;
+			copied.reserve((std::size_t)(end - begin));
+			for (std::uint64_t i = begin; i < end; i++) {
+				const Slot &slot = ring.slots[i % ring.capacity];
+				std::uint64_t kind = slot.kind.load(std::memory_order_relaxed);
+				std::uint64_t counts = slot.counts.load(std::memory_order_relaxed);
+				copied.push_back(Decoded{slot.time.load(std::memory_order_relaxed),
+					(const void *)slot.lock.load(std::memory_order_relaxed),
+					(Event)(kind & 0xf), (Mode)((kind >> 4) & 1), (std::uint32_t)(kind >> 32),
+					unpack(counts, 0), unpack(counts, 16), unpack(counts, 32), unpack(counts, 48)});
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			std::uint64_t overwritten = ring.started.load(std::memory_order_relaxed);
+			std::uint64_t firstIntact = overwritten > ring.capacity ? overwritten - ring.capacity : 0;
+			for (std::uint64_t i = std::max(begin, firstIntact); i < end; i++)
+				out.push_back(copied[(std::size_t)(i - begin)]);
+		}
+
+		static const char *modeName(Mode mode) {
+			return mode == Mode::exclusive ? "exclusive" : "shared";
+		}
+
+	public:
+		FlightRecorder() {
+		}
+
+		// Installs the recorder as the tracer. Threads that start recording
+		// afterwards get rings of eventsPerThread events.
+		void start(std::size_t eventsPerThread = 1 << 14) {
+			this->eventsPerThread.store(eventsPerThread, std::memory_order_relaxed);
+			set_tracer(&FlightRecorder::trace);
+		}
+
+		// Stops recording; the history is kept for later dumps.
+		void stop() {
+			set_tracer(nullptr);
+		}
+
+		// Forgets the history recorded so far, e.g. between tests.
+		void clear() {
+			std::unique_lock<std::mutex> lock(m);
+			for (Ring *ring : rings)
+				ring->cleared.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+		}
+
+		// Timestamps events with `now`, which counts ticksPerNanosecond per
+		// nanosecond, instead of the TSC; nullptr restores the TSC. For tests
+		// that need exact times.
+		void set_clock(Clock now, double ticksPerNanosecond = 1.0) {
+			clockTicksPerNanosecond.store(ticksPerNanosecond, std::memory_order_relaxed);
+			clock.store(now, std::memory_order_relaxed);
+		}
+
+		// Writes the events of the last `window` (everything if zero) as Chrome
+		// trace JSON. Safe to call while other threads keep recording.
+		void write_chrome_trace(std::ostream &os, std::chrono::nanoseconds window = std::chrono::nanoseconds(0)) {
+			std::vector<Decoded> events;
+			{
+				std::unique_lock<std::mutex> lock(m);
+				for (const Ring *ring : rings)
+					copy(*ring, events);
+			}
+			std::stable_sort(events.begin(), events.end(), [](const Decoded &a, const Decoded &b) {
+				return a.time < b.time;
+			});
+
+			double ticksPerNanosecond = clock.load(std::memory_order_relaxed) ?
+				clockTicksPerNanosecond.load(std::memory_order_relaxed) : shared_mutex_stats::ticksPerNanosecond();
+			double ticksPerMicrosecond = ticksPerNanosecond * 1000.0;
+			std::uint64_t first = events.empty() ? 0 : events.front().time;
+			if (!events.empty() && window.count() > 0) {
+				std::uint64_t span = (std::uint64_t)(window.count() * ticksPerNanosecond);
+				if (events.back().time - first > span)
+					first = events.back().time - span;
+			}
+
+			char line[512];
+			bool comma = false;
+			auto emit = [&](const char *text) {
+				os << (comma ? ",\n" : "\n") << text;
+				comma = true;
+			};
+			auto micros = [&](std::uint64_t time) {
+				return (double)(time - first) / ticksPerMicrosecond;
+			};
+
+			os << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+			std::map<std::uint32_t, bool> threads;
+			// per thread and lock: acquire_start time, whether it blocked, grant time
+			struct Open
+			{
+				std::uint64_t start = 0;
+				bool started = false;
+				bool contended = false;
+				std::vector<std::uint64_t> granted;
+			};
+			std::map<std::pair<std::uint32_t, const void *>, Open> open;
+
+			for (const Decoded &e : events) {
+				if (e.time < first)
+					continue;
+				if (!threads[e.thread]) {
+					threads[e.thread] = true;
+					std::snprintf(line, sizeof line,
+						"{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"thread %u\"}}",
+						e.thread, e.thread);
+					emit(line);
+				}
+				Open &o = open[{e.thread, e.lock}];
+				switch (e.event) {
+				case Event::acquire_start:
+					o.start = e.time;
+					o.started = true;
+					o.contended = false;
+					break;
+				case Event::contended_wait:
+					o.contended = true;
+					break;
+				case Event::wake:
+					break;
+				case Event::acquire_granted:
+					if (o.started && o.contended) {
+						std::snprintf(line, sizeof line,
+							"{\"ph\": \"X\", \"cat\": \"wait\", \"name\": \"wait %s\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"lock\": \"%p\"}}",
+							modeName(e.mode), e.thread, micros(o.start), micros(e.time) - micros(o.start), e.lock);
+						emit(line);
+					}
+					o.started = false;
+					o.granted.push_back(e.time);
+					break;
+				case Event::release:
+					if (!o.granted.empty()) {
+						std::uint64_t granted = o.granted.back();
+						o.granted.pop_back();
+						std::snprintf(line, sizeof line,
+							"{\"ph\": \"X\", \"cat\": \"hold\", \"name\": \"hold %s\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, "
+							"\"args\": {\"lock\": \"%p\", \"woken readers\": %d, \"woken writers\": %d}}",
+							modeName(e.mode), e.thread, micros(granted), micros(e.time) - micros(granted), e.lock, e.wokenReaders, e.wokenWriters);
+					}
+					else {
+						std::snprintf(line, sizeof line,
+							"{\"ph\": \"i\", \"s\": \"t\", \"cat\": \"hold\", \"name\": \"release %s\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, "
+							"\"args\": {\"lock\": \"%p\", \"woken readers\": %d, \"woken writers\": %d}}",
+							modeName(e.mode), e.thread, micros(e.time), e.lock, e.wokenReaders, e.wokenWriters);
+					}
+					emit(line);
+					break;
+				}
+			}
+			os << "\n]}\n";
+		}
+	};
+
+	inline FlightRecorder &flightRecorder() {
+		// never destroyed: threads may record while static destructors run
+		static FlightRecorder *recorder = new FlightRecorder;
+		return *recorder;
+	}
+
+	inline void FlightRecorder::trace(const Record &record) {
+		flightRecorder().record(record);
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+
+// Number of readers holding a SharedMutex or AsyncSharedMutex. 64 bits wide,
+// so parallel and nested readers (coroutines hold a shared lock without a
+// thread each) are not limited to 2^31, and adding readers past
+// SHARED_MUTEX_MAX_READERS throws std::overflow_error instead of wrapping to
+// a count that would let a writer in. Lower the limit to test the overflow
+// paths without that many readers; `max` can also be given explicitly.
+//
+// Queued readers are admitted in a batch by a releasing writer, which must
+// not fail, so a reader is checked when it arrives against the readers
+// inside plus those already queued: see check().
+
+#if !defined(SHARED_MUTEX_MAX_READERS)
+#define SHARED_MUTEX_MAX_READERS UINT64_MAX
+#endif
+
+template<std::uint64_t max = SHARED_MUTEX_MAX_READERS>
+class SharedMutexReaderCount
+{
+	std::uint64_t n = 0;
+
+public:
+	operator std::uint64_t() const {
+		return n;
+	}
+
+	// Throws std::overflow_error unless `more` readers can be added.
+	void check(std::uint64_t more) const {
+		if (more > max - n)
+			throw std::overflow_error("too many readers");
+	}
+
+	SharedMutexReaderCount &operator+=(std::uint64_t more) {
+		check(more);
+		n += more;
+		return *this;
+	}
+
+	void operator++(int) {
+		*this += 1;
+	}
+
+	// The caller has checked that a reader holds the lock.
+	void operator--(int) {
+		n--;
+	}
+};
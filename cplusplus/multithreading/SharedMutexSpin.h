@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <sched.h>
+
+// Adaptive spinning for SharedMutex, compiled in with SHARED_MUTEX_SPIN.
+//
+// Parking a waiter costs two context switches, far more than a short critical
+// section. With this mode a thread that finds the lock held by a writer first
+// spins, without m, for up to SHARED_MUTEX_SPIN_NS (default 20 us) waiting
+// for the writer to release, and parks as before only if it does not.
+//
+// Spinning only pays while the holder is running, and Linux cannot tell one
+// thread whether another is on a CPU (rseq reports a thread's own CPU only).
+// The writer publishes the CPU it acquired the lock on, and a waiter does not
+// spin, or stops, when it finds itself on that CPU: the holder cannot be
+// running there at the same time. That catches holder and waiter sharing a
+// CPU, the usual case with more threads than CPUs, and nothing else. The CPU
+// is sampled once, so a writer that migrated afterwards leaves a stale one,
+// and a writer preempted by another thread on its own CPU goes unnoticed;
+// the spinner then wastes up to SHARED_MUTEX_SPIN_NS before parking. Keep
+// the limit near the cost of a park and wake-up. At most one thread spins
+// per lock; the rest park at once, so a preempted writer does not return to
+// a CPU full of spinning readers. Parked waiters are woken by the release as
+// usual.
+//
+// Whether it pays on a given machine shows in the benchmark's handoff mode:
+// compare sharedmutex_bench with sharedmutex_bench_spin.
+
+#if !defined(SHARED_MUTEX_SPIN_NS)
+#define SHARED_MUTEX_SPIN_NS 20000
+#endif
+
+class SharedMutexSpin
+{
+	// generation << 32 | (cpu + 1) of the current writer, low half 0 when no
+	// writer with a known CPU holds the lock. Written under SharedMutex::m.
+	std::atomic<std::uint64_t> owner{0};
+	std::atomic<bool> spinning{false};
+
+	static void pause() {
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__)
+		asm volatile("yield");
+#endif
+	}
+
+public:
+	// Called with m held by a thread that acquired the lock exclusively.
+	void owner_acquired() {
+		std::uint64_t generation = (owner.load(std::memory_order_relaxed) >> 32) + 1;
+		owner.store(generation << 32 | (std::uint32_t)(sched_getcpu() + 1), std::memory_order_relaxed);
+	}
+
+	// Called with m held when the writer releases the lock.
+	void owner_released() {
+		owner.store(owner.load(std::memory_order_relaxed) & ~0xffffffffull, std::memory_order_relaxed);
+	}
+
+	// Called with m held while a writer holds the lock. Spins with m released
+	// unless the writer is known not to be running. Returns true if the writer released (or
+	// the lock changed hands) during the spin, so the caller should look again;
+	// false if it should park. Either way m is held again on return.
+	template<class Lock>
+	bool spin(Lock &lock) {
+		std::uint64_t held = owner.load(std::memory_order_relaxed);
+		int cpu = (int)(std::uint32_t)held - 1;
+		if (cpu < 0 || cpu == sched_getcpu() || spinning.exchange(true, std::memory_order_acquire))
+			return false;
+		lock.unlock();
+		bool released = false;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(SHARED_MUTEX_SPIN_NS);
+		for (unsigned i = 1;; i++) {
+			pause();
+			if (owner.load(std::memory_order_relaxed) != held) {
+				released = true;
+				break;
+			}
+			if (i % 64 == 0 && (sched_getcpu() == cpu || std::chrono::steady_clock::now() > deadline))
+				break;
+		}
+		spinning.store(false, std::memory_order_release);
+		lock.lock();
+		return released;
+	}
+};
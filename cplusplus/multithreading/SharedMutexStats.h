@@ -0,0 +1,367 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#if defined(SHARED_MUTEX_HISTOGRAMS)
+#include "LatencyHistogram.h"
+#endif
+
+// Contention statistics for SharedMutex, compiled in with SHARED_MUTEX_STATS.
+// The macro changes the layout of SharedMutex, so it must be defined the same
+// way in every translation unit of a program.
+//
+// Every instance registers itself on construction; name it with
+// SharedMutex("cache.index") to make it recognizable in
+// shared_mutex_stats::dump_hottest(std::cerr).
+//
+// SHARED_MUTEX_HISTOGRAMS additionally records wait and hold latency
+// distributions per mode, exported by dump_latency_text()/dump_latency_json().
+
+namespace shared_mutex_stats
+{
+	// Cheap timestamp: TSC ticks on x86, steady_clock nanoseconds elsewhere.
+	inline std::uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	inline double ticksPerNanosecond() {
+#if defined(__x86_64__) || defined(__i386__)
+		static const double ratio = [] {
+			auto clockBegin = std::chrono::steady_clock::now();
+			std::uint64_t ticksBegin = now();
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			auto clockEnd = std::chrono::steady_clock::now();
+			std::uint64_t ticksEnd = now();
+			double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(clockEnd - clockBegin).count();
+			return (double)(ticksEnd - ticksBegin) / ns;
+		}();
+		return ratio;
+#else
+		return 1.0;
+#endif
+	}
+}
+
+class SharedMutexStats
+{
+public:
+	struct Mode
+	{
+		std::uint64_t acquisitions = 0;
+		std::uint64_t contended = 0;
+		std::uint64_t waitNs = 0;
+		std::uint64_t holdNs = 0;
+#if defined(SHARED_MUTEX_HISTOGRAMS)
+		LatencyHistogram waitLatency;
+		LatencyHistogram holdLatency;
+#endif
+	};
+
+	struct Snapshot
+	{
+		std::string name;
+		Mode shared;
+		Mode exclusive;
+		std::uint64_t maxReaders = 0;
+
+		std::uint64_t waitNs() const { return shared.waitNs + exclusive.waitNs; }
+	};
+
+private:
+	struct Counters
+	{
+		std::atomic<std::uint64_t> acquisitions{0};
+		std::atomic<std::uint64_t> contended{0};
+		std::atomic<std::uint64_t> waitTicks{0};
+		std::atomic<std::uint64_t> holdTicks{0};
+	};
+
+	struct Registry
+	{
+		std::mutex m;
+		std::vector<SharedMutexStats *> instances;
+	};
+
+	static Registry &registry() {
+		// never destroyed, so mutexes with static storage can unregister at exit
+		static Registry *instance = new Registry;
+		return *instance;
+	}
+
+	// Counters written only under the owning SharedMutex's m use load+store
+	// instead of a locked read-modify-write; they are atomic only so that
+	// snapshot() can read them concurrently.
+	static void add(std::atomic<std::uint64_t> &counter, std::uint64_t value) {
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	void updateReaders(std::uint64_t holdDelta, std::uint64_t nReaders) {
+		unsigned version = readersVersion.load(std::memory_order_relaxed);
+		readersVersion.store(version + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		add(shared.holdTicks, holdDelta);
+		readers.store(nReaders, std::memory_order_relaxed);
+		readersVersion.store(version + 2, std::memory_order_release);
+	}
+
+#if defined(SHARED_MUTEX_HISTOGRAMS)
+	// Shared hold latency needs each reader's own start time, kept per thread
+	// for the few shared locks a thread holds at once.
+	struct HeldShared
+	{
+		const SharedMutexStats *stats;
+		std::uint64_t since;
+	};
+
+	struct HeldSharedStack
+	{
+		static const int capacity = 16;
+		HeldShared entries[capacity];
+		int size = 0;
+	};
+
+	static HeldSharedStack &heldShared() {
+		static thread_local HeldSharedStack stack;
+		return stack;
+	}
+
+	StripedLatencyHistogram sharedWaitLatency;
+	StripedLatencyHistogram sharedHoldLatency;
+	StripedLatencyHistogram exclusiveWaitLatency;
+	StripedLatencyHistogram exclusiveHoldLatency;
+#endif
+
+	const char *name;
+	Counters shared;
+	Counters exclusive;
+	std::atomic<std::uint64_t> readers{0};
+	std::atomic<std::uint64_t> maxReaders{0};
+	std::atomic<unsigned> readersVersion{0};   // odd while shared.holdTicks and readers disagree
+	std::uint64_t exclusiveSince = 0;
+
+public:
+	explicit SharedMutexStats(const char *name = nullptr) : name(name) {
+		Registry &r = registry();
+		std::unique_lock<std::mutex> lock(r.m);
+		r.instances.push_back(this);
+	}
+
+	~SharedMutexStats() {
+		Registry &r = registry();
+		std::unique_lock<std::mutex> lock(r.m);
+		r.instances.erase(std::find(r.instances.begin(), r.instances.end(), this));
+	}
+
+	SharedMutexStats(const SharedMutexStats &) = delete;
+	SharedMutexStats &operator=(const SharedMutexStats &) = delete;
+
+	// The methods below are called by SharedMutex with its m held, except
+	// shared_waited(), which an admitted reader calls after waking up.
+	// waitStart is 0 for an acquisition that did not wait.
+
+	void exclusive_acquired(std::uint64_t waitStart, bool contended) {
+		std::uint64_t t = shared_mutex_stats::now();
+		add(exclusive.acquisitions, 1);
+		if (contended)
+			add(exclusive.contended, 1);
+		if (waitStart) {
+			add(exclusive.waitTicks, t - waitStart);
+#if defined(SHARED_MUTEX_HISTOGRAMS)
+			exclusiveWaitLatency.record(t - waitStart);
+#endif
+		}
+		exclusiveSince = t;
+	}
+
+	void exclusive_released() {
+		std::uint64_t held = shared_mutex_stats::now() - exclusiveSince;
+		add(exclusive.holdTicks, held);
+#if defined(SHARED_MUTEX_HISTOGRAMS)
+		exclusiveHoldLatency.record(held);
+#endif
+	}
+
+	// Shared hold time is accumulated as sum(release) - sum(acquire), which
+	// needs no per-reader state; snapshot() adds the readers still inside.
+	void shared_acquired(int n, std::uint64_t nReaders, bool contended) {
+		std::uint64_t t = shared_mutex_stats::now();
+		add(shared.acquisitions, n);
+		if (contended)
+			add(shared.contended, n);
+		updateReaders(0 - t * n, nReaders);
+		if (nReaders > maxReaders.load(std::memory_order_relaxed))
+			maxReaders.store(nReaders, std::memory_order_relaxed);
+	}
+
+	void shared_released(std::uint64_t nReaders) {
+		std::uint64_t t = shared_mutex_stats::now();
+		updateReaders(t, nReaders);
+#if defined(SHARED_MUTEX_HISTOGRAMS)
+		// a lock released by another thread than the one that took it is not found
+		HeldSharedStack &held = heldShared();
+		for (int i = held.size - 1; i >= 0; i--) {
+			if (held.entries[i].stats == this) {
+				sharedHoldLatency.record(t - held.entries[i].since);
+				held.entries[i] = held.entries[--held.size];
+				break;
+			}
+		}
+#endif
+	}
+
+	// Called on the reader's own thread once it holds the lock.
+	void shared_entered() {
+#if defined(SHARED_MUTEX_HISTOGRAMS)
+		HeldSharedStack &held = heldShared();
+		if (held.size < HeldSharedStack::capacity)
+			held.entries[held.size++] = HeldShared{this, shared_mutex_stats::now()};
+#endif
+	}
+
+	void shared_waited(std::uint64_t waitStart) {
+		std::uint64_t waited = shared_mutex_stats::now() - waitStart;
+		shared.waitTicks.fetch_add(waited, std::memory_order_relaxed);
+#if defined(SHARED_MUTEX_HISTOGRAMS)
+		sharedWaitLatency.record(waited);
+#endif
+		shared_entered();
+	}
+
+	// Counters are read without stopping the mutex, so a snapshot taken under
+	// load may be off by the operations in flight.
+	Snapshot snapshot() const {
+		double perNs = shared_mutex_stats::ticksPerNanosecond();
+		auto convert = [perNs](const Counters &c, Mode &mode) {
+			mode.acquisitions = c.acquisitions.load(std::memory_order_relaxed);
+			mode.contended = c.contended.load(std::memory_order_relaxed);
+			mode.waitNs = (std::uint64_t)(c.waitTicks.load(std::memory_order_relaxed) / perNs);
+		};
+
+		Snapshot s;
+		if (name) {
+			s.name = name;
+		}
+		else {
+			char buffer[32];
+			std::snprintf(buffer, sizeof buffer, "SharedMutex@%p", (const void *)this);
+			s.name = buffer;
+		}
+		convert(shared, s.shared);
+		convert(exclusive, s.exclusive);
+		std::uint64_t sharedHold;
+		for (;;) {
+			unsigned version = readersVersion.load(std::memory_order_acquire);
+			std::uint64_t t = shared_mutex_stats::now();
+			sharedHold = shared.holdTicks.load(std::memory_order_relaxed) + t * readers.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (!(version & 1) && readersVersion.load(std::memory_order_relaxed) == version)
+				break;
+			std::this_thread::yield();
+		}
+		s.shared.holdNs = (std::uint64_t)(sharedHold / perNs);
+		s.exclusive.holdNs = (std::uint64_t)(exclusive.holdTicks.load(std::memory_order_relaxed) / perNs);
+		s.maxReaders = maxReaders.load(std::memory_order_relaxed);
+#if defined(SHARED_MUTEX_HISTOGRAMS)
+		s.shared.waitLatency = sharedWaitLatency.snapshot(perNs);
+		s.shared.holdLatency = sharedHoldLatency.snapshot(perNs);
+		s.exclusive.waitLatency = exclusiveWaitLatency.snapshot(perNs);
+		s.exclusive.holdLatency = exclusiveHoldLatency.snapshot(perNs);
+#endif
+		return s;
+	}
+
+	static std::vector<Snapshot> snapshot_all() {
+		std::vector<Snapshot> all;
+		Registry &r = registry();
+		std::unique_lock<std::mutex> lock(r.m);
+		for (SharedMutexStats *stats : r.instances)
+			all.push_back(stats->snapshot());
+		return all;
+	}
+};
+
+namespace shared_mutex_stats
+{
+	// Prints the `limit` registered mutexes with the most total wait time.
+	inline void dump_hottest(std::ostream &os, std::size_t limit = 20) {
+		std::vector<SharedMutexStats::Snapshot> all = SharedMutexStats::snapshot_all();
+		std::sort(all.begin(), all.end(), [](const SharedMutexStats::Snapshot &a, const SharedMutexStats::Snapshot &b) {
+			return a.waitNs() > b.waitNs();
+		});
+		if (all.size() > limit)
+			all.resize(limit);
+
+		char line[256];
+		std::snprintf(line, sizeof line, "%-32s %-9s %12s %12s %8s %14s %14s %11s\n",
+			"lock", "mode", "acquired", "contended", "cont%", "wait ms", "hold ms", "max readers");
+		os << line;
+		for (const auto &s : all) {
+			const SharedMutexStats::Mode *modes[] = { &s.exclusive, &s.shared };
+			const char *modeNames[] = { "exclusive", "shared" };
+			for (int i = 0; i < 2; i++) {
+				const SharedMutexStats::Mode &mode = *modes[i];
+				double percent = mode.acquisitions ? 100.0 * mode.contended / mode.acquisitions : 0.0;
+				std::string maxReaders = i == 1 ? std::to_string(s.maxReaders) : "";
+				std::snprintf(line, sizeof line, "%-32s %-9s %12llu %12llu %7.1f%% %14.3f %14.3f %11s\n",
+					s.name.c_str(), modeNames[i],
+					(unsigned long long)mode.acquisitions, (unsigned long long)mode.contended, percent,
+					mode.waitNs / 1e6, mode.holdNs / 1e6, maxReaders.c_str());
+				os << line;
+			}
+		}
+	}
+
+#if defined(SHARED_MUTEX_HISTOGRAMS)
+	// Wait and hold latency percentiles in nanoseconds, one line per lock,
+	// mode and measurement: "<lock> <mode> <wait|hold> count=.. p50=.. ...".
+	inline void dump_latency_text(std::ostream &os) {
+		for (const auto &s : SharedMutexStats::snapshot_all()) {
+			s.exclusive.waitLatency.print_text(os, s.name + " exclusive wait");
+			s.exclusive.holdLatency.print_text(os, s.name + " exclusive hold");
+			s.shared.waitLatency.print_text(os, s.name + " shared wait");
+			s.shared.holdLatency.print_text(os, s.name + " shared hold");
+		}
+	}
+
+	// The same data as a JSON array of
+	// {"lock": .., "mode": .., "wait": {..}, "hold": {..}} objects.
+	inline void dump_latency_json(std::ostream &os) {
+		os << "[";
+		bool first = true;
+		for (const auto &s : SharedMutexStats::snapshot_all()) {
+			const SharedMutexStats::Mode *modes[] = { &s.exclusive, &s.shared };
+			const char *modeNames[] = { "exclusive", "shared" };
+			for (int i = 0; i < 2; i++) {
+				os << (first ? "\n  " : ",\n  ");
+				first = false;
+				os << "{\"lock\": \"";
+				for (char c : s.name) {
+					if (c == '"' || c == '\\')
+						os << '\\';
+					os << c;
+				}
+				os << "\", \"mode\": \"" << modeNames[i] << "\", \"wait\": ";
+				modes[i]->waitLatency.print_json(os);
+				os << ", \"hold\": ";
+				modes[i]->holdLatency.print_json(os);
+				os << "}";
+			}
+		}
+		os << "\n]\n";
+	}
+#endif
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include "SharedMutexTrace.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+// Deterministic waiting for lock tests, in place of sleeping and hoping the
+// other threads got far enough.
+//
+//   ThreadHarness harness;
+//   std::thread reader = harness.spawn(lockReader, std::ref(m), ...);
+//   harness.settle();   // reader has either returned or is blocked in m
+//
+// Requires SHARED_MUTEX_TRACE: a thread counts as blocked from its
+// contended_wait event until a release wakes it. settle() returns once every
+// spawned thread has finished or is blocked with no wakeup still on its way,
+// so the state the test asserts on can no longer change by itself. This
+// relies on a lock emitting each release before the waiters it wakes can emit
+// their wake: a wake seen first would leave the release's count pending for a
+// thread that is still blocked.
+// One harness can be installed at a time. Events are passed on to the tracer
+// installed before it, such as a flight recorder under test.
+class ThreadHarness
+{
+	struct Tracked
+	{
+		const void *blockedOn = nullptr;
+		bool finished = false;
+	};
+
+	std::mutex m;
+	std::condition_variable changed;
+	std::list<Tracked> tracked;
+	std::map<const void *, int> pendingWakes;   // woken by a release, not yet running
+	shared_mutex_trace::Tracer previous;
+
+	static ThreadHarness *&installed() {
+		static ThreadHarness *instance = nullptr;
+		return instance;
+	}
+
+	static Tracked *&current() {
+		static thread_local Tracked *tracked = nullptr;
+		return tracked;
+	}
+
+	static void trace(const shared_mutex_trace::Record &record) {
+		ThreadHarness *harness = installed();
+		if (harness->previous)
+			harness->previous(record);
+		harness->event(record);
+	}
+
+	void event(const shared_mutex_trace::Record &record) {
+		using shared_mutex_trace::Event;
+		std::unique_lock<std::mutex> lock(m);
+		Tracked *self = current();
+		if (record.event == Event::contended_wait && self) {
+			self->blockedOn = record.lock;
+		}
+		else if (record.event == Event::wake && self && self->blockedOn) {
+			int &pending = pendingWakes[self->blockedOn];
+			if (pending > 0)
+				pending--;
+			self->blockedOn = nullptr;
+		}
+		else if (record.wokenReaders + record.wokenWriters > 0) {
+			// a writer notified twice before it runs is woken only once
+			int blocked = 0;
+			for (const Tracked &t : tracked)
+				if (t.blockedOn == record.lock)
+					blocked++;
+			int &pending = pendingWakes[record.lock];
+			pending = std::min(pending + record.wokenReaders + record.wokenWriters, blocked);
+		}
+		else {
+			return;
+		}
+		changed.notify_all();
+	}
+
+	bool settled() {
+		for (auto it = tracked.begin(); it != tracked.end();) {
+			if (it->finished) {
+				it = tracked.erase(it);
+				continue;
+			}
+			if (!it->blockedOn || pendingWakes[it->blockedOn] > 0)
+				return false;
+			++it;
+		}
+		return true;
+	}
+
+public:
+	ThreadHarness() : previous(shared_mutex_trace::tracer().load(std::memory_order_acquire)) {
+		installed() = this;
+		shared_mutex_trace::set_tracer(&ThreadHarness::trace);
+	}
+
+	~ThreadHarness() {
+		shared_mutex_trace::set_tracer(previous);
+		installed() = nullptr;
+	}
+
+	ThreadHarness(const ThreadHarness &) = delete;
+	ThreadHarness &operator=(const ThreadHarness &) = delete;
+
+	// Starts a thread running f(args...) that settle() waits for.
+	template<class F, class... Args>
+	std::thread spawn(F f, Args... args) {
+		Tracked *t;
+		{
+			std::unique_lock<std::mutex> lock(m);
+			tracked.emplace_back();
+			t = &tracked.back();
+		}
+		return std::thread([this, t, f, args...]() mutable {
+			current() = t;
+			f(args...);
+			std::unique_lock<std::mutex> lock(m);
+			t->finished = true;
+			changed.notify_all();
+		});
+	}
+
+	// Waits until every spawned thread has finished or is blocked.
+	void settle() {
+		std::unique_lock<std::mutex> lock(m);
+		if (!changed.wait_for(lock, std::chrono::seconds(10), [this] { return settled(); }))
+			throw std::runtime_error("ThreadHarness::settle(): threads still running after 10 s");
+	}
+};
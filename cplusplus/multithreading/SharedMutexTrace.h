@@ -0,0 +1,160 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SHARED_MUTEX_USDT 1
+#endif
+#endif
+
+// Static tracepoints in SharedMutex, compiled in with SHARED_MUTEX_TRACE.
+//
+// Every blocking acquisition and release emits events carrying the lock
+// address, the mode and the number of blocked readers and writers:
+//
+//   acquire_start    a thread calls lock()/shared_lock()
+//   contended_wait   it is about to block
+//   wake             it returned from blocking
+//   acquire_granted  it holds the lock
+//   release          unlock()/shared_unlock(); also counts the waiters it woke,
+//                    and comes before any of their wake events
+//
+// Where <sys/sdt.h> is available each event is a USDT probe in provider
+// "shared_mutex" (a nop until a tracer such as bpftrace or perf attaches), so
+// lock waits can be traced in production without recompiling. Independently,
+// an in-process tracer can be installed with shared_mutex_trace::set_tracer();
+// TraceRecorder below is a ready-made one that keeps the latest events in a
+// ring buffer. Tracers run with the SharedMutex's internal mutex held for all
+// events except the wake and acquire_granted of a batch-admitted reader, so
+// they must be short and must not touch the traced lock.
+
+namespace shared_mutex_trace
+{
+	enum class Event { acquire_start, contended_wait, wake, acquire_granted, release };
+	enum class Mode { shared, exclusive };
+
+	struct Record
+	{
+		Event event;
+		Mode mode;
+		const void *lock;
+		int waitingReaders;   // -1 where not known without the internal mutex
+		int waitingWriters;
+		int wokenReaders;     // release, and acquire_granted of a lock passed on to the next waiter
+		int wokenWriters;
+	};
+
+	typedef void (*Tracer)(const Record &record);
+
+	inline std::atomic<Tracer> &tracer() {
+		static std::atomic<Tracer> instance{nullptr};
+		return instance;
+	}
+
+	// Installs f as the process-wide tracer, or removes it with nullptr.
+	inline void set_tracer(Tracer f) {
+		tracer().store(f, std::memory_order_release);
+	}
+
+	inline void emit(Event event, Mode mode, const void *lock, int waitingReaders, int waitingWriters, int wokenReaders = 0, int wokenWriters = 0) {
+#if defined(SHARED_MUTEX_USDT)
+		int exclusive = mode == Mode::exclusive;
+		switch (event) {
+		case Event::acquire_start:
+			DTRACE_PROBE4(shared_mutex, acquire_start, lock, exclusive, waitingReaders, waitingWriters);
+			break;
+		case Event::contended_wait:
+			DTRACE_PROBE4(shared_mutex, contended_wait, lock, exclusive, waitingReaders, waitingWriters);
+			break;
+		case Event::wake:
+			DTRACE_PROBE4(shared_mutex, wake, lock, exclusive, waitingReaders, waitingWriters);
+			break;
+		case Event::acquire_granted:
+			DTRACE_PROBE4(shared_mutex, acquire_granted, lock, exclusive, waitingReaders, waitingWriters);
+			break;
+		case Event::release:
+			DTRACE_PROBE6(shared_mutex, release, lock, exclusive, waitingReaders, waitingWriters, wokenReaders, wokenWriters);
+			break;
+		}
+#endif
+		Tracer f = tracer().load(std::memory_order_acquire);
+		if (f)
+			f(Record{event, mode, lock, waitingReaders, waitingWriters, wokenReaders, wokenWriters});
+	}
+
+	// Tracer that keeps the last `capacity` events, with timestamps and
+	// thread ids, in a process-wide ring buffer. Only one can be installed.
+	class TraceRecorder
+	{
+	public:
+		struct Entry
+		{
+			Record record;
+			std::thread::id thread;
+			std::chrono::steady_clock::time_point time;
+		};
+
+	private:
+		static std::atomic<TraceRecorder *> &installed() {
+			static std::atomic<TraceRecorder *> instance{nullptr};
+			return instance;
+		}
+
+		static void trace(const Record &record) {
+			if (TraceRecorder *recorder = installed().load(std::memory_order_acquire))
+				recorder->push(Entry{record, std::this_thread::get_id(), std::chrono::steady_clock::now()});
+		}
+
+		std::mutex m;
+		std::vector<Entry> ring;
+		std::size_t next = 0;
+		std::size_t capacity;
+
+		void push(const Entry &entry) {
+			std::unique_lock<std::mutex> lock(m);
+			if (ring.size() < capacity)
+				ring.push_back(entry);
+			else
+				ring[next % capacity] = entry;
+			next++;
+		}
+
+	public:
+		explicit TraceRecorder(std::size_t capacity = 4096) : capacity(capacity) {
+			ring.reserve(capacity);
+			installed().store(this, std::memory_order_release);
+			set_tracer(&TraceRecorder::trace);
+		}
+
+		~TraceRecorder() {
+			set_tracer(nullptr);
+			installed().store(nullptr, std::memory_order_release);
+		}
+
+		TraceRecorder(const TraceRecorder &) = delete;
+		TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+		// Recorded events, oldest first.
+		std::vector<Entry> entries() {
+			std::unique_lock<std::mutex> lock(m);
+			if (ring.size() < capacity)
+				return ring;
+			std::vector<Entry> ordered;
+			ordered.reserve(capacity);
+			for (std::size_t i = 0; i < capacity; i++)
+				ordered.push_back(ring[(next + i) % capacity]);
+			return ordered;
+		}
+
+		void clear() {
+			std::unique_lock<std::mutex> lock(m);
+			ring.clear();
+			next = 0;
+		}
+	};
+}
@@ -0,0 +1,131 @@
+#include "BenchmarkResults.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+// Usage: sharedmutex_bench_compare baseline.json candidate.json [--threshold percent] [--alpha p]
+//
+// Compares two runs written by sharedmutex_bench --json, series
+// by series. A series is flagged as a regression or an improvement when its
+// median moved by more than the threshold (default 5%) and the samples differ
+// at significance alpha (default 0.05). Changes are signed so that positive
+// means the candidate is better. Exits with 1 if anything regressed.
+//
+// The samples of a series are its repetitions (--repeat). Fewer than 4 per
+// side can never be significant at 0.05; such series are reported as
+// inconclusive and the exit status is 3, so a short run does not pass as
+// "0 regressions". So is a series found in only one run, such as a mode that
+// crashed or was dropped: it is listed as missing or added, also with 3.
+
+benchmark_results::Results load(const char *path)
+{
+	std::ifstream file(path);
+	if (!file) {
+		std::fprintf(stderr, "cannot open %s\n", path);
+		std::exit(2);
+	}
+	try {
+		return benchmark_results::Results::read_json(file);
+	}
+	catch (const std::exception &e) {
+		std::fprintf(stderr, "%s: %s\n", path, e.what());
+		std::exit(2);
+	}
+}
+
+void printMachine(const char *label, const benchmark_results::Results &results)
+{
+	const benchmark_results::Machine &m = results.machine;
+	std::printf("%-10s %s, %s, %d cores, %s, %s, %s\n", label, results.timestamp.c_str(), m.cpu.c_str(), m.cores,
+		m.kernel.c_str(), m.compiler.c_str(), m.flags.c_str());
+}
+
+// "-" for the run a series is missing from.
+std::string formatMedian(double median)
+{
+	if (std::isnan(median))
+		return "-";
+	char text[32];
+	std::snprintf(text, sizeof text, "%.2f", median);
+	return text;
+}
+
+int main(int argc, char **argv)
+{
+	const char *paths[2] = {nullptr, nullptr};
+	int nPaths = 0;
+	double threshold = 5;
+	double alpha = 0.05;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+			threshold = std::atof(argv[++i]);
+		else if (std::strcmp(argv[i], "--alpha") == 0 && i + 1 < argc)
+			alpha = std::atof(argv[++i]);
+		else if (nPaths < 2)
+			paths[nPaths++] = argv[i];
+	}
+	if (nPaths != 2) {
+		std::fprintf(stderr, "usage: %s baseline.json candidate.json [--threshold percent] [--alpha p]\n", argv[0]);
+		return 2;
+	}
+
+	benchmark_results::Results baseline = load(paths[0]);
+	benchmark_results::Results candidate = load(paths[1]);
+	printMachine("baseline", baseline);
+	printMachine("candidate", candidate);
+	const benchmark_results::Machine &b = baseline.machine;
+	const benchmark_results::Machine &c = candidate.machine;
+	if (b.cpu != c.cpu || b.cores != c.cores || b.kernel != c.kernel || b.compiler != c.compiler || b.flags != c.flags)
+		std::printf("warning: the runs differ in machine or build, differences may not come from the lock\n");
+	std::printf("threshold %.1f%%, alpha %.3f\n\n", threshold, alpha);
+
+	std::printf("%-56s %14s %14s %8s %8s  %s\n", "series", "baseline", "candidate", "change", "p", "");
+	int regressions = 0;
+	int improvements = 0;
+	int inconclusive = 0;
+	int unmatched = 0;
+	for (const auto &comparison : benchmark_results::compare(baseline, candidate, threshold, alpha)) {
+		const char *verdict = "";
+		if (comparison.verdict == benchmark_results::Verdict::regressed) {
+			verdict = "REGRESSION";
+			regressions++;
+		}
+		else if (comparison.verdict == benchmark_results::Verdict::improved) {
+			verdict = "improved";
+			improvements++;
+		}
+		else if (comparison.verdict == benchmark_results::Verdict::inconclusive) {
+			verdict = "too few samples";
+			inconclusive++;
+		}
+		else if (comparison.verdict == benchmark_results::Verdict::missing) {
+			verdict = "MISSING from candidate";
+			unmatched++;
+		}
+		else if (comparison.verdict == benchmark_results::Verdict::added) {
+			verdict = "only in candidate";
+			unmatched++;
+		}
+		if (std::isnan(comparison.p)) {
+			// in one run only: just the median it has
+			std::printf("%-56s %14s %14s %8s %8s  %s\n", comparison.name.c_str(), formatMedian(comparison.baseline).c_str(),
+				formatMedian(comparison.candidate).c_str(), "", "", verdict);
+			continue;
+		}
+		std::printf("%-56s %14.2f %14.2f %+7.1f%% %8.4f  %s\n", comparison.name.c_str(), comparison.baseline,
+			comparison.candidate, comparison.change, comparison.p, verdict);
+	}
+	std::printf("\n%d regressions, %d improvements\n", regressions, improvements);
+	if (inconclusive) {
+		std::printf("error: %d series have too few samples to be significant at alpha %.3f; rerun with a larger --repeat\n",
+			inconclusive, alpha);
+	}
+	if (unmatched)
+		std::printf("error: %d series appear in only one run\n", unmatched);
+	if (regressions)
+		return 1;
+	return inconclusive || unmatched ? 3 : 0;
+}
@@ -0,0 +1,696 @@
+#include "SharedMutex.h"
+#include "BenchmarkResults.h"
+#include "FlatCombiningSharedMutex.h"
+#include "LatencyHistogram.h"
+#include "SharedMutexStats.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Usage: sharedmutex_bench [mode] [--repeat n] [--json file]
+//   throughput   ops/s of every lock over threads x write ratio x critical section
+//   latency      reader and writer latency percentiles at a fixed arrival rate
+//   fairness     Jain index of per-thread acquisitions and longest waits
+//   fastpath     ns per uncontended lock/unlock pair, single pinned thread
+//   handoff      writers passing the lock back and forth, and how often they park
+//   combining    lock()/unlock() versus FlatCombiningSharedMutex::combine()
+//   all          every mode (default)
+//
+// --repeat runs the selected modes n times; --json writes every measured
+// series with one sample per repetition, plus machine and build metadata, for
+// comparison with sharedmutex_bench_compare. That comparison needs at least
+// 4 samples per side to find anything significant at 0.05, so with --json
+// the default is 5 repetitions, otherwise 1.
+//
+// sharedmutex_bench_spin is the same benchmark built with SHARED_MUTEX_SPIN;
+// its SharedMutex rows are named SharedMutex+spin.
+//
+// Exits with status 1 if a measurement was unreliable, e.g. a fast-path row
+// rejected more than 5% of its samples as outliers; such rows are printed but
+// not stored.
+
+std::chrono::milliseconds runDuration(200);
+
+benchmark_results::Results results;
+
+// Runs nThreads threads calling operation() in a loop for runDuration and
+// returns the combined number of operations per second.
+template<class Operation>
+double measure(int nThreads, Operation operation)
+{
+	std::atomic<bool> start{false};
+	std::atomic<bool> stop{false};
+	std::atomic<long long> total{0};
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < nThreads; t++) {
+		threads.emplace_back([&] {
+			while (!start.load(std::memory_order_acquire))
+				std::this_thread::yield();
+			long long n = 0;
+			while (!stop.load(std::memory_order_relaxed)) {
+				operation();
+				n++;
+			}
+			total.fetch_add(n);
+		});
+	}
+
+	auto begin = std::chrono::steady_clock::now();
+	start.store(true, std::memory_order_release);
+	std::this_thread::sleep_for(runDuration);
+	stop.store(true);
+	for (auto &t : threads)
+		t.join();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+	return total.load() / elapsed.count();
+}
+
+// Tiny counter updates from 1..64 writers: one lock handoff per update with
+// lock()/unlock() versus one handoff per batch with combine().
+void benchmark_flatCombining()
+{
+	std::printf("flat combining, counter increment\n");
+	std::printf("%8s %18s %18s\n", "writers", "lock ops/s", "combine ops/s");
+	for (int nWriters = 1; nWriters <= 64; nWriters *= 2) {
+		SharedMutex plain;
+		long long plainCounter = 0;
+		double plainRate = measure(nWriters, [&] {
+			plain.lock();
+			plainCounter++;
+			plain.unlock();
+		});
+
+		FlatCombiningSharedMutex combining;
+		long long combinedCounter = 0;
+		double combinedRate = measure(nWriters, [&] {
+			combining.combine([&] { combinedCounter++; });
+		});
+
+		std::printf("%8d %18.0f %18.0f\n", nWriters, plainRate, combinedRate);
+		std::string writers = "/writers=" + std::to_string(nWriters);
+		results.add("combining/lock" + writers, "ops/s", true, plainRate);
+		results.add("combining/combine" + writers, "ops/s", true, combinedRate);
+	}
+}
+
+// Adapters giving every lock the same interface.
+struct SharedMutexLock
+{
+#if defined(SHARED_MUTEX_SPIN)
+	static const char *name() { return "SharedMutex+spin"; }
+#else
+	static const char *name() { return "SharedMutex"; }
+#endif
+	SharedMutex m;
+	void lock() { m.lock(); }
+	void unlock() { m.unlock(); }
+	void lock_shared() { m.shared_lock(); }
+	void unlock_shared() { m.shared_unlock(); }
+};
+
+struct StdSharedMutexLock
+{
+	static const char *name() { return "std::shared_mutex"; }
+	std::shared_mutex m;
+	void lock() { m.lock(); }
+	void unlock() { m.unlock(); }
+	void lock_shared() { m.lock_shared(); }
+	void unlock_shared() { m.unlock_shared(); }
+};
+
+struct PthreadRwlockLock
+{
+	static const char *name() { return "pthread_rwlock_t"; }
+	pthread_rwlock_t m;
+	PthreadRwlockLock() { pthread_rwlock_init(&m, nullptr); }
+	~PthreadRwlockLock() { pthread_rwlock_destroy(&m); }
+	void lock() { pthread_rwlock_wrlock(&m); }
+	void unlock() { pthread_rwlock_unlock(&m); }
+	void lock_shared() { pthread_rwlock_rdlock(&m); }
+	void unlock_shared() { pthread_rwlock_unlock(&m); }
+};
+
+// Readers take it exclusively too: the baseline a reader-writer lock must beat.
+struct StdMutexLock
+{
+	static const char *name() { return "std::mutex"; }
+	std::mutex m;
+	void lock() { m.lock(); }
+	void unlock() { m.unlock(); }
+	void lock_shared() { m.lock(); }
+	void unlock_shared() { m.unlock(); }
+};
+
+// Data guarded by the lock under test. A critical section of length n reads
+// (shared) or updates (exclusive) n words of it.
+struct Protected
+{
+	std::uint64_t words[64] = {};
+
+	std::uint64_t read(int length) const {
+		std::uint64_t sum = 0;
+		for (int i = 0; i < length; i++)
+			sum += words[i % 64];
+		return sum;
+	}
+
+	void write(int length) {
+		for (int i = 0; i < length; i++)
+			words[i % 64]++;
+	}
+};
+
+// Cheap per-thread random numbers for picking reads versus writes.
+inline std::uint32_t nextRandom()
+{
+	static thread_local std::uint32_t state = 2463534242u + (std::uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+std::vector<int> threadCounts()
+{
+	int maxThreads = 2 * (int)std::max(1u, std::thread::hardware_concurrency());
+	std::vector<int> counts;
+	for (int n = 1; n < maxThreads; n *= 2)
+		counts.push_back(n);
+	counts.push_back(maxThreads);
+	return counts;
+}
+
+const int writePerMille[] = {0, 10, 100, 500};
+const int criticalSectionLengths[] = {0, 16, 256};
+
+template<class Lock>
+double measureMix(int nThreads, int writesPerMille, int length)
+{
+	Lock lock;
+	Protected data;
+	std::atomic<std::uint64_t> sink{0};
+	return measure(nThreads, [&] {
+		if ((int)(nextRandom() % 1000) < writesPerMille) {
+			lock.lock();
+			data.write(length);
+			lock.unlock();
+		}
+		else {
+			lock.lock_shared();
+			std::uint64_t sum = data.read(length);
+			lock.unlock_shared();
+			if (sum == 1)
+				sink.fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+}
+
+template<class Lock>
+void throughputRow(int nThreads, int writesPerMille, int length)
+{
+	double rate = measureMix<Lock>(nThreads, writesPerMille, length);
+	std::printf("%-18s %8d %5d/%-4d %6d %16.0f\n", Lock::name(), nThreads,
+		100 - writesPerMille / 10, writesPerMille / 10, length, rate);
+	results.add(std::string("throughput/") + Lock::name() + "/threads=" + std::to_string(nThreads) + "/writes=" +
+		std::to_string(writesPerMille) + "/cs=" + std::to_string(length), "ops/s", true, rate);
+}
+
+// The baseline for lock changes: every lock over the full sweep.
+void benchmark_throughput()
+{
+	std::printf("throughput, %lld ms per point\n", (long long)runDuration.count());
+	std::printf("%-18s %8s %10s %6s %16s\n", "lock", "threads", "read/write", "cs", "ops/s");
+	for (int length : criticalSectionLengths) {
+		for (int writes : writePerMille) {
+			for (int nThreads : threadCounts()) {
+				throughputRow<SharedMutexLock>(nThreads, writes, length);
+				throughputRow<StdSharedMutexLock>(nThreads, writes, length);
+				throughputRow<PthreadRwlockLock>(nThreads, writes, length);
+				throughputRow<StdMutexLock>(nThreads, writes, length);
+			}
+		}
+	}
+}
+
+// Open-loop load: each thread issues operations on a fixed schedule instead of
+// back to back, and an operation's latency is measured from when it was due,
+// not from when the thread got round to it. A stall therefore counts against
+// every operation it delayed (coordinated omission correction), which is
+// what a client issuing requests at that rate would see.
+const int latencyRate = 200000;   // operations per second, all threads together
+const std::chrono::milliseconds latencyDuration(1000);
+
+struct LatencyResult
+{
+	LatencyHistogram readers;
+	LatencyHistogram writers;
+};
+
+template<class Lock>
+LatencyResult measureLatency(int nThreads, int writesPerMille, int length)
+{
+	typedef std::chrono::steady_clock Clock;
+	Lock lock;
+	Protected data;
+	std::atomic<std::uint64_t> sink{0};
+	std::vector<LatencyResult> perThread(nThreads);
+	std::chrono::nanoseconds interval(1000000000ll * nThreads / latencyRate);
+	Clock::time_point begin = Clock::now() + std::chrono::milliseconds(10);
+	Clock::time_point end = begin + latencyDuration;
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < nThreads; t++) {
+		threads.emplace_back([&, t] {
+			LatencyResult &result = perThread[t];
+			// threads are staggered so arrivals are spread evenly
+			Clock::time_point due = begin + interval * t / nThreads;
+			for (; due < end; due += interval) {
+				while (Clock::now() < due)
+					std::this_thread::yield();
+				bool write = (int)(nextRandom() % 1000) < writesPerMille;
+				if (write) {
+					lock.lock();
+					data.write(length);
+					lock.unlock();
+				}
+				else {
+					lock.lock_shared();
+					if (data.read(length) == 1)
+						sink.fetch_add(1, std::memory_order_relaxed);
+					lock.unlock_shared();
+				}
+				std::uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - due).count();
+				(write ? result.writers : result.readers).record(ns);
+			}
+		});
+	}
+	for (auto &t : threads)
+		t.join();
+
+	LatencyResult merged;
+	for (auto &result : perThread) {
+		merged.readers.merge(result.readers);
+		merged.writers.merge(result.writers);
+	}
+	return merged;
+}
+
+void latencyRow(const char *lock, const char *role, const LatencyHistogram &h)
+{
+	std::printf("%-18s %-7s %9llu %9llu %9llu %9llu %9llu %9llu %11llu\n", lock, role, (unsigned long long)h.count(),
+		(unsigned long long)h.percentile(50), (unsigned long long)h.percentile(90), (unsigned long long)h.percentile(99),
+		(unsigned long long)h.percentile(99.9), (unsigned long long)h.percentile(99.99), (unsigned long long)h.max());
+	std::string series = std::string("latency/") + lock + "/" + role;
+	results.add(series + "/p50", "ns", false, (double)h.percentile(50));
+	results.add(series + "/p99", "ns", false, (double)h.percentile(99));
+	results.add(series + "/p99.9", "ns", false, (double)h.percentile(99.9));
+}
+
+template<class Lock>
+void latencyRows(int nThreads)
+{
+	LatencyResult result = measureLatency<Lock>(nThreads, 100, 16);
+	latencyRow(Lock::name(), "reader", result.readers);
+	latencyRow(Lock::name(), "writer", result.writers);
+}
+
+// Tail latency that closed-loop throughput hides: writer starvation and the
+// herd of readers woken together show up in p99 and beyond.
+void benchmark_latency()
+{
+	int nThreads = 2 * (int)std::max(1u, std::thread::hardware_concurrency());
+	std::printf("latency, %d ops/s over %d threads for %lld ms, 90/10 read/write, cs 16, ns from scheduled start\n",
+		latencyRate, nThreads, (long long)latencyDuration.count());
+	std::printf("%-18s %-7s %9s %9s %9s %9s %9s %9s %11s\n", "lock", "role", "count", "p50", "p90", "p99", "p99.9", "p99.99", "max");
+	latencyRows<SharedMutexLock>(nThreads);
+	latencyRows<StdSharedMutexLock>(nThreads);
+	latencyRows<PthreadRwlockLock>(nThreads);
+	latencyRows<StdMutexLock>(nThreads);
+}
+
+struct FairnessResult
+{
+	std::vector<long long> acquisitions;   // per thread, readers first
+	std::chrono::nanoseconds maxReaderWait{0};
+	std::chrono::nanoseconds maxWriterWait{0};
+};
+
+// Jain's fairness index: 1 when every thread got the same share, 1/n when
+// one thread got everything.
+double jainIndex(const std::vector<long long> &counts)
+{
+	double sum = 0;
+	double sumSquares = 0;
+	for (long long c : counts) {
+		sum += (double)c;
+		sumSquares += (double)c * (double)c;
+	}
+	return sumSquares == 0 ? 1.0 : sum * sum / (counts.size() * sumSquares);
+}
+
+// Closed loop with dedicated reader and writer threads, each timing how long
+// every acquisition waited.
+template<class Lock>
+FairnessResult measureFairness(int nReaders, int nWriters, int length)
+{
+	typedef std::chrono::steady_clock Clock;
+	Lock lock;
+	Protected data;
+	std::atomic<std::uint64_t> sink{0};
+	std::atomic<bool> start{false};
+	std::atomic<bool> stop{false};
+	FairnessResult result;
+	result.acquisitions.resize(nReaders + nWriters);
+	std::vector<std::chrono::nanoseconds> maxWait(nReaders + nWriters);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < nReaders + nWriters; t++) {
+		threads.emplace_back([&, t] {
+			bool writer = t >= nReaders;
+			long long n = 0;
+			std::chrono::nanoseconds longest{0};
+			while (!start.load(std::memory_order_acquire))
+				std::this_thread::yield();
+			while (!stop.load(std::memory_order_relaxed)) {
+				Clock::time_point requested = Clock::now();
+				if (writer) {
+					lock.lock();
+					longest = std::max(longest, std::chrono::nanoseconds(Clock::now() - requested));
+					data.write(length);
+					lock.unlock();
+				}
+				else {
+					lock.lock_shared();
+					longest = std::max(longest, std::chrono::nanoseconds(Clock::now() - requested));
+					if (data.read(length) == 1)
+						sink.fetch_add(1, std::memory_order_relaxed);
+					lock.unlock_shared();
+				}
+				n++;
+			}
+			result.acquisitions[t] = n;
+			maxWait[t] = longest;
+		});
+	}
+
+	start.store(true, std::memory_order_release);
+	std::this_thread::sleep_for(runDuration);
+	stop.store(true);
+	for (auto &t : threads)
+		t.join();
+	// a thread still waiting when stop is set finishes its wait, so it is counted
+	for (int t = 0; t < nReaders + nWriters; t++) {
+		std::chrono::nanoseconds &roleMax = t < nReaders ? result.maxReaderWait : result.maxWriterWait;
+		roleMax = std::max(roleMax, maxWait[t]);
+	}
+	return result;
+}
+
+template<class Lock>
+void fairnessRow(int nReaders, int nWriters, int length)
+{
+	FairnessResult result = measureFairness<Lock>(nReaders, nWriters, length);
+	long long readerOps = 0;
+	long long writerOps = 0;
+	for (int t = 0; t < nReaders + nWriters; t++)
+		(t < nReaders ? readerOps : writerOps) += result.acquisitions[t];
+	std::vector<long long> readers(result.acquisitions.begin(), result.acquisitions.begin() + nReaders);
+	std::vector<long long> writers(result.acquisitions.begin() + nReaders, result.acquisitions.end());
+	std::printf("%-18s %6.3f %6.3f %6.3f %12lld %12lld %14.1f %14.1f\n", Lock::name(),
+		jainIndex(result.acquisitions), jainIndex(readers), jainIndex(writers), readerOps, writerOps,
+		result.maxReaderWait.count() / 1000.0, result.maxWriterWait.count() / 1000.0);
+	std::string series = std::string("fairness/") + Lock::name();
+	results.add(series + "/jain", "index", true, jainIndex(result.acquisitions));
+	results.add(series + "/max_reader_wait", "us", false, result.maxReaderWait.count() / 1000.0);
+	results.add(series + "/max_writer_wait", "us", false, result.maxWriterWait.count() / 1000.0);
+}
+
+// Writer starvation under read load: readers hold the lock back to back with
+// long critical sections, so a lock that always admits new readers keeps
+// writers out. Reported per lock as fairness over all threads and within each
+// role, and the longest wait of any reader and any writer.
+void benchmark_fairness()
+{
+	int nThreads = 2 * (int)std::max(2u, std::thread::hardware_concurrency());
+	int nWriters = std::max(1, nThreads / 4);
+	int nReaders = nThreads - nWriters;
+	const int length = 256;
+	std::printf("fairness, %d readers and %d writers, cs %d, %lld ms\n", nReaders, nWriters, length, (long long)runDuration.count());
+	std::printf("%-18s %6s %6s %6s %12s %12s %14s %14s\n", "lock", "jain", "jainR", "jainW",
+		"reader ops", "writer ops", "max R wait us", "max W wait us");
+	fairnessRow<SharedMutexLock>(nReaders, nWriters, length);
+	fairnessRow<StdSharedMutexLock>(nReaders, nWriters, length);
+	fairnessRow<PthreadRwlockLock>(nReaders, nWriters, length);
+	fairnessRow<StdMutexLock>(nReaders, nWriters, length);
+}
+
+long long voluntaryContextSwitches()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_nvcsw;
+}
+
+template<class Lock>
+void handoffRow(int nThreads, int length)
+{
+	long long switchesBefore = voluntaryContextSwitches();
+	double rate = measureMix<Lock>(nThreads, 1000, length);
+	long long switches = voluntaryContextSwitches() - switchesBefore;
+	double parks = switches * 1000.0 / (rate * std::chrono::duration<double>(runDuration).count());
+	std::printf("%-18s %8d %6d %16.0f %14.2f\n", Lock::name(), nThreads, length, rate, parks);
+	std::string series = std::string("handoff/") + Lock::name() + "/threads=" + std::to_string(nThreads) + "/cs=" + std::to_string(length);
+	results.add(series, "ops/s", true, rate);
+	results.add(series + "/parks", "per 1000 ops", false, parks);
+}
+
+// Writers handing the lock to each other with critical sections far shorter
+// than a park and wake-up, the case SHARED_MUTEX_SPIN is for. Parks are the
+// process's voluntary context switches per 1000 operations. Spinning needs
+// the holder running on another CPU, so thread counts stay within the CPUs.
+void benchmark_handoff()
+{
+	int nCpus = (int)std::max(1u, std::thread::hardware_concurrency());
+	std::printf("handoff, writes only, %lld ms per point\n", (long long)runDuration.count());
+	std::printf("%-18s %8s %6s %16s %14s\n", "lock", "threads", "cs", "ops/s", "parks/1k ops");
+	for (int length : {0, 16}) {
+		for (int nThreads = 2; nThreads <= std::max(2, nCpus); nThreads *= 2) {
+			handoffRow<SharedMutexLock>(nThreads, length);
+			handoffRow<StdMutexLock>(nThreads, length);
+		}
+	}
+}
+
+// Serialized TSC reads: nothing before begin() and after end() leaks into the
+// timed region. Elsewhere falls back to steady_clock nanoseconds.
+inline std::uint64_t timerBegin()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	_mm_lfence();
+	std::uint64_t t = __rdtsc();
+	_mm_lfence();
+	return t;
+#else
+	return shared_mutex_stats::now();
+#endif
+}
+
+inline std::uint64_t timerEnd()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned aux;
+	std::uint64_t t = __rdtscp(&aux);
+	_mm_lfence();
+	return t;
+#else
+	return shared_mutex_stats::now();
+#endif
+}
+
+// Pins the calling thread to the CPU it is running on, so migrations and
+// TSC differences between cores stay out of the samples.
+void pinToCurrentCpu()
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(std::max(0, sched_getcpu()), &set);
+	pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+}
+
+const int fastPathBatch = 100;      // pairs per sample, amortizes the timer
+const int fastPathSamples = 2000;
+const int fastPathWarmup = 100000;
+const double fastPathMaxRejected = 0.05;   // of samples; more means a noisy machine, not outliers
+
+// Set when a mode could not measure reliably; the benchmark then exits with 1.
+bool measurementFailed = false;
+
+struct FastPathResult
+{
+	double minNs;
+	double medianNs;
+	double meanNs;
+	int rejected;
+};
+
+// Times `samples` batches of operation(), subtracts the cost of an empty
+// batch and drops outliers (interrupts, preemption) more than 3 median
+// absolute deviations above the median. The deviation is floored at 5% of
+// the median: uncontended batches often deviate by less than a tick, yet
+// timer jitter of a few percent is not an outlier, while an interrupt adds
+// microseconds to a batch. Results are per operation.
+template<class Operation>
+FastPathResult measureFastPath(Operation operation)
+{
+	for (int i = 0; i < fastPathWarmup; i++)
+		operation();
+
+	auto sample = [](auto &&body) {
+		std::uint64_t begin = timerBegin();
+		for (int i = 0; i < fastPathBatch; i++)
+			body();
+		return (double)(timerEnd() - begin);
+	};
+	std::vector<double> empty;
+	std::vector<double> ticks;
+	for (int s = 0; s < fastPathSamples; s++) {
+		empty.push_back(sample([] { asm volatile("" ::: "memory"); }));
+		ticks.push_back(sample(operation));
+	}
+	auto median = [](std::vector<double> v) {
+		std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+		return v[v.size() / 2];
+	};
+	double overhead = median(empty);
+	double center = median(ticks);
+	std::vector<double> deviations;
+	for (double t : ticks)
+		deviations.push_back(t > center ? t - center : center - t);
+	double limit = center + 3 * std::max({1.0, center / 20, median(deviations)});
+
+	std::vector<double> kept;
+	for (double t : ticks)
+		if (t <= limit)
+			kept.push_back(std::max(0.0, t - overhead));
+	double sum = 0;
+	for (double t : kept)
+		sum += t;
+	double perOp = shared_mutex_stats::ticksPerNanosecond() * fastPathBatch;
+	return FastPathResult{*std::min_element(kept.begin(), kept.end()) / perOp, median(kept) / perOp,
+		sum / kept.size() / perOp, (int)(ticks.size() - kept.size())};
+}
+
+void fastPathRow(const char *lock, const char *pair, const FastPathResult &result)
+{
+	std::printf("%-18s %-28s %8.2f %8.2f %8.2f %9d\n", lock, pair, result.minNs, result.medianNs, result.meanNs, result.rejected);
+	if (result.rejected > fastPathSamples * fastPathMaxRejected) {
+		// what is left is biased towards the fast samples, so it is not stored
+		std::fprintf(stderr, "error: %s %s: %d of %d samples rejected as outliers, machine too noisy\n", lock, pair, result.rejected, fastPathSamples);
+		measurementFailed = true;
+		return;
+	}
+	results.add(std::string("fastpath/") + lock + "/" + pair, "ns", false, result.medianNs);
+}
+
+template<class Lock>
+void fastPathRows()
+{
+	Lock lock;
+	fastPathRow(Lock::name(), "lock+unlock", measureFastPath([&] {
+		lock.lock();
+		lock.unlock();
+	}));
+	fastPathRow(Lock::name(), "lock_shared+unlock_shared", measureFastPath([&] {
+		lock.lock_shared();
+		lock.unlock_shared();
+	}));
+}
+
+// The uncontended round trip that most acquisitions pay, for tracking from
+// commit to commit. Runs on its own pinned thread: the modes after it, and
+// later repetitions, must keep every CPU.
+void benchmark_fastPath()
+{
+	std::thread measure([] {
+		pinToCurrentCpu();
+		std::printf("uncontended fast path, %d samples of %d pairs, ns per pair\n", fastPathSamples, fastPathBatch);
+		std::printf("%-18s %-28s %8s %8s %8s %9s\n", "lock", "pair", "min", "median", "mean", "outliers");
+		fastPathRows<SharedMutexLock>();
+		fastPathRows<StdSharedMutexLock>();
+		fastPathRows<PthreadRwlockLock>();
+		fastPathRows<StdMutexLock>();
+	});
+	measure.join();
+}
+
+int main(int argc, char **argv)
+{
+	const char *mode = "all";
+	const char *jsonPath = nullptr;
+	int repeat = 0;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+			repeat = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+			jsonPath = argv[++i];
+		else
+			mode = argv[i];
+	}
+	if (repeat == 0)
+		repeat = jsonPath ? 5 : 1;
+	bool all = std::strcmp(mode, "all") == 0;
+	bool known = all;
+	for (const char *m : {"throughput", "latency", "fairness", "fastpath", "handoff", "combining"})
+		known = known || std::strcmp(mode, m) == 0;
+	if (!known) {
+		std::fprintf(stderr, "unknown mode %s; expected throughput, latency, fairness, fastpath, handoff, combining or all\n", mode);
+		return 1;
+	}
+
+	results.machine = benchmark_results::Machine::current();
+	results.timestamp = benchmark_results::Results::now();
+	for (int r = 0; r < repeat; r++) {
+		if (repeat > 1)
+			std::printf("repetition %d of %d\n", r + 1, repeat);
+		if (all || std::strcmp(mode, "throughput") == 0)
+			benchmark_throughput();
+		if (all || std::strcmp(mode, "latency") == 0)
+			benchmark_latency();
+		if (all || std::strcmp(mode, "fairness") == 0)
+			benchmark_fairness();
+		if (all || std::strcmp(mode, "fastpath") == 0)
+			benchmark_fastPath();
+		if (all || std::strcmp(mode, "handoff") == 0)
+			benchmark_handoff();
+		if (all || std::strcmp(mode, "combining") == 0)
+			benchmark_flatCombining();
+	}
+
+	if (jsonPath) {
+		std::ofstream file(jsonPath);
+		results.write_json(file);
+		if (!file) {
+			std::fprintf(stderr, "cannot write %s\n", jsonPath);
+			return 1;
+		}
+	}
+	return measurementFailed ? 1 : 0;
+}
@@ -0,0 +1,252 @@
+#include "ModelChecker.h"
+#define SHARED_MUTEX_MUTEX model_check::Mutex
+#define SHARED_MUTEX_CONDITION_VARIABLE model_check::ConditionVariable
+#define SHARED_MUTEX_ATOMIC model_check::Atomic
+#include "SharedMutex.h"
+#include <chrono>
+#include <cstdio>
+#include <cassert>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using model_check::check;
+
+// nReaders readers and nWriters writers each entering the lock `rounds`
+// times, with a scheduling point inside every critical section. Shadow
+// counters check mutual exclusion; explore() itself checks that every thread
+// finishes, so a lost wakeup or deadlock fails the run.
+template<class Lock, int nReaders, int nWriters, int rounds = 1>
+struct ReadersWriters
+{
+	Lock m;
+	int readersInside = 0;
+	int writersInside = 0;
+	int writes = 0;
+
+	int threads() {
+		return nReaders + nWriters;
+	}
+
+	void run(int thread) {
+		for (int i = 0; i < rounds; i++) {
+			if (thread < nWriters) {
+				m.lock();
+				check(writersInside == 0, "two writers inside");
+				check(readersInside == 0, "writer inside with readers");
+				writersInside++;
+				model_check::yield();
+				writersInside--;
+				writes++;
+				m.unlock();
+			}
+			else {
+				m.shared_lock();
+				check(writersInside == 0, "reader inside with a writer");
+				readersInside++;
+				model_check::yield();
+				readersInside--;
+				m.shared_unlock();
+			}
+		}
+	}
+
+	void finish() {
+		check(writes == nWriters * rounds, "lost write");
+		check(readersInside == 0 && writersInside == 0, "threads left inside");
+	}
+};
+
+// A writer racing a timed writer and a timed reader, which may give up at
+// any point but must never be left waiting forever.
+struct TimedWaiters
+{
+	SharedMutex m;
+	int readersInside = 0;
+	int writersInside = 0;
+
+	int threads() {
+		return 3;
+	}
+
+	void enterWriter() {
+		check(writersInside == 0 && readersInside == 0, "writer inside with another holder");
+		writersInside++;
+		model_check::yield();
+		writersInside--;
+		m.unlock();
+	}
+
+	void run(int thread) {
+		if (thread == 0) {
+			m.lock();
+			enterWriter();
+		}
+		else if (thread == 1) {
+			if (m.try_lock_for(std::chrono::seconds(1)))
+				enterWriter();
+		}
+		else if (m.try_shared_lock_for(std::chrono::seconds(1))) {
+			check(writersInside == 0, "reader inside with a writer");
+			readersInside++;
+			model_check::yield();
+			readersInside--;
+			m.shared_unlock();
+		}
+	}
+
+	void finish() {
+		check(readersInside == 0 && writersInside == 0, "threads left inside");
+	}
+};
+
+// Deliberately broken: shared_unlock() does not wake a blocked writer.
+class LostWakeupLock
+{
+	model_check::Mutex m;
+	model_check::ConditionVariable cond_var;
+	int nReaders = 0;
+	bool hasWriter = false;
+
+public:
+	void lock() {
+		std::unique_lock<model_check::Mutex> lock(m);
+		while (hasWriter || nReaders > 0)
+			cond_var.wait(lock);
+		hasWriter = true;
+	}
+
+	void unlock() {
+		std::unique_lock<model_check::Mutex> lock(m);
+		hasWriter = false;
+		cond_var.notify_all();
+	}
+
+	void shared_lock() {
+		std::unique_lock<model_check::Mutex> lock(m);
+		while (hasWriter)
+			cond_var.wait(lock);
+		nReaders++;
+	}
+
+	void shared_unlock() {
+		std::unique_lock<model_check::Mutex> lock(m);
+		nReaders--;
+	}
+};
+
+// Dekker's entry without the retry: a thread raises its flag and enters only
+// if the other's flag is down. Excludes the other thread only if the flag
+// store is ordered before the load, which seq_cst gives and release does not.
+template<std::memory_order storeOrder>
+struct DekkerEntry
+{
+	model_check::Atomic<bool> flags[2];
+	int inside = 0;
+
+	int threads() {
+		return 2;
+	}
+
+	void run(int thread) {
+		flags[thread].store(true, storeOrder);
+		if (!flags[1 - thread].load(std::memory_order_acquire)) {
+			check(inside == 0, "two threads inside");
+			inside++;
+			model_check::yield();
+			inside--;
+		}
+		flags[thread].store(false, storeOrder);
+	}
+
+	void finish() {
+	}
+};
+
+// Runs f in a child process and returns whether it aborted.
+template<class F>
+bool aborts(F f)
+{
+	std::fflush(stderr);
+	pid_t child = fork();
+	if (child == 0) {
+		freopen("/dev/null", "w", stderr);
+		f();
+		_exit(0);
+	}
+	int status = 0;
+	waitpid(child, &status, 0);
+	return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+
+template<class Scenario>
+void explore(const char *name, model_check::Options options = model_check::Options())
+{
+	model_check::Result result = model_check::explore<Scenario>(options);
+	std::printf("%-52s %8lld executions\n", name, result.executions);
+}
+
+void test_sharedMutex_2writers()
+{
+	explore<ReadersWriters<SharedMutex, 0, 2, 2>>("SharedMutex 2 writers x2");
+}
+
+void test_sharedMutex_2readers1writer()
+{
+	explore<ReadersWriters<SharedMutex, 2, 1>>("SharedMutex 2 readers 1 writer");
+}
+
+void test_sharedMutex_1reader2writers()
+{
+	explore<ReadersWriters<SharedMutex, 1, 2>>("SharedMutex 1 reader 2 writers");
+}
+
+void test_sharedMutex_2readers2writers()
+{
+	explore<ReadersWriters<SharedMutex, 2, 2>>("SharedMutex 2 readers 2 writers");
+}
+
+void test_sharedMutex_3readers1writer_twice()
+{
+	model_check::Options options;
+	options.preemptionBound = 1;
+	explore<ReadersWriters<SharedMutex, 3, 1, 2>>("SharedMutex 3 readers 1 writer x2, bound 1", options);
+}
+
+void test_sharedMutex_timedWaiters()
+{
+	explore<TimedWaiters>("SharedMutex lock, try_lock_for, try_shared_lock_for");
+}
+
+void test_lostWakeup_detected()
+{
+	assert(aborts([] { model_check::explore<ReadersWriters<LostWakeupLock, 1, 1>>(); }));
+}
+
+void test_dekkerEntry_seqCst()
+{
+	explore<DekkerEntry<std::memory_order_seq_cst>>("Dekker entry, seq_cst stores");
+}
+
+void test_dekkerEntry_release_storeBufferingDetected()
+{
+	assert(aborts([] { model_check::explore<DekkerEntry<std::memory_order_release>>(); }));
+
+	// = the same reordering is missed when stores are visible at once
+	model_check::Options options;
+	options.maxStoreDelay = 0;
+	model_check::explore<DekkerEntry<std::memory_order_release>>(options);
+}
+
+int main()
+{
+	test_sharedMutex_2writers();
+	test_sharedMutex_2readers1writer();
+	test_sharedMutex_1reader2writers();
+	test_sharedMutex_2readers2writers();
+	test_sharedMutex_3readers1writer_twice();
+	test_sharedMutex_timedWaiters();
+	test_lostWakeup_detected();
+	test_dekkerEntry_seqCst();
+	test_dekkerEntry_release_storeBufferingDetected();
+	return 0;
+}
@@ -0,0 +1,190 @@
+#include "SharedMutex.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Usage: Source17_stress_shared_mutex [threads] [milliseconds]
+//
+// Many threads run random lock(), shared_lock(), try_lock(),
+// try_shared_lock(), try_lock_for() and try_shared_lock_for() calls against
+// one SharedMutex. Every acquisition is checked against a shadow state:
+// never two writers, never a writer with readers, and at most one reader per
+// thread inside. Prints throughput per operation and, if any invariant broke,
+// the first violation, exiting with 1.
+
+enum Operation { opLock, opSharedLock, opTryLock, opTrySharedLock, opTryLockFor, opTrySharedLockFor, nOperations };
+
+const char *operationNames[nOperations] = {
+	"lock", "shared_lock", "try_lock", "try_shared_lock", "try_lock_for", "try_shared_lock_for",
+};
+
+// Out of 100: mostly readers, as in production.
+const int operationWeights[nOperations] = {10, 50, 5, 15, 5, 15};
+
+struct Shadow
+{
+	std::atomic<int> writers{0};
+	std::atomic<int> readers{0};
+	std::atomic<long long> violations{0};
+	std::mutex m;
+	std::string firstViolation;
+
+	void violation(const std::string &what) {
+		if (violations.fetch_add(1) == 0) {
+			std::unique_lock<std::mutex> lock(m);
+			firstViolation = what;
+		}
+	}
+
+	void enterWriter() {
+		if (writers.fetch_add(1) != 0)
+			violation("two writers inside");
+		int r = readers.load();
+		if (r != 0)
+			violation("writer inside with " + std::to_string(r) + " readers");
+	}
+
+	void exitWriter() {
+		writers.fetch_sub(1);
+	}
+
+	void enterReader(int nThreads) {
+		int r = readers.fetch_add(1) + 1;
+		if (writers.load() != 0)
+			violation("reader inside with a writer");
+		if (r > nThreads)
+			violation("reader count " + std::to_string(r) + " exceeds thread count");
+	}
+
+	void exitReader() {
+		if (readers.fetch_sub(1) <= 0)
+			violation("reader count went negative");
+	}
+};
+
+struct Counts
+{
+	long long attempts[nOperations] = {};
+	long long acquired[nOperations] = {};
+};
+
+Operation pick(std::uint32_t random)
+{
+	int r = (int)(random % 100);
+	for (int op = 0; op < nOperations; op++) {
+		if (r < operationWeights[op])
+			return (Operation)op;
+		r -= operationWeights[op];
+	}
+	return opSharedLock;
+}
+
+int main(int argc, char **argv)
+{
+	int nThreads = argc > 1 ? std::atoi(argv[1]) : 256;
+	int milliseconds = argc > 2 ? std::atoi(argv[2]) : 1000;
+
+	SharedMutex m;
+	Shadow shadow;
+	std::vector<Counts> counts(nThreads);
+	std::atomic<bool> stop{false};
+	std::uint64_t data = 0;
+	std::atomic<std::uint64_t> readTotal{0};
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < nThreads; t++) {
+		threads.emplace_back([&, t] {
+			std::uint32_t random = 2463534242u + 7919u * (std::uint32_t)t;
+			auto next = [&] {
+				random ^= random << 13;
+				random ^= random >> 17;
+				random ^= random << 5;
+				return random;
+			};
+			Counts &c = counts[t];
+			std::uint64_t sink = 0;
+			while (!stop.load(std::memory_order_relaxed)) {
+				Operation op = pick(next());
+				auto timeout = std::chrono::microseconds(next() % 200);
+				bool exclusive = op == opLock || op == opTryLock || op == opTryLockFor;
+				bool acquired = true;
+				switch (op) {
+				case opLock: m.lock(); break;
+				case opSharedLock: m.shared_lock(); break;
+				case opTryLock: acquired = m.try_lock(); break;
+				case opTrySharedLock: acquired = m.try_shared_lock(); break;
+				case opTryLockFor: acquired = m.try_lock_for(timeout); break;
+				case opTrySharedLockFor: acquired = m.try_shared_lock_for(timeout); break;
+				default: break;
+				}
+				c.attempts[op]++;
+				if (!acquired)
+					continue;
+				c.acquired[op]++;
+				if (exclusive) {
+					shadow.enterWriter();
+					data++;
+					if (next() % 64 == 0)
+						std::this_thread::yield();
+					shadow.exitWriter();
+					m.unlock();
+				}
+				else {
+					shadow.enterReader(nThreads);
+					sink += data;
+					if (next() % 64 == 0)
+						std::this_thread::yield();
+					shadow.exitReader();
+					m.shared_unlock();
+				}
+			}
+			readTotal.fetch_add(sink, std::memory_order_relaxed);
+		});
+	}
+
+	auto begin = std::chrono::steady_clock::now();
+	std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+	stop.store(true);
+	for (auto &t : threads)
+		t.join();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+	// quiescent: the lock itself must agree that nobody holds it
+	if (shadow.writers.load() != 0 || shadow.readers.load() != 0)
+		shadow.violation("shadow state not empty after all threads finished");
+	if (!m.try_lock())
+		shadow.violation("lock still held after all threads finished");
+	else
+		m.unlock();
+
+	Counts total;
+	for (const Counts &c : counts) {
+		for (int op = 0; op < nOperations; op++) {
+			total.attempts[op] += c.attempts[op];
+			total.acquired[op] += c.acquired[op];
+		}
+	}
+	std::printf("%d threads, %.2f s\n", nThreads, elapsed.count());
+	std::printf("%-20s %14s %14s %14s\n", "operation", "attempts", "acquired", "acquired/s");
+	long long all = 0;
+	for (int op = 0; op < nOperations; op++) {
+		std::printf("%-20s %14lld %14lld %14.0f\n", operationNames[op], total.attempts[op], total.acquired[op],
+			total.acquired[op] / elapsed.count());
+		all += total.acquired[op];
+	}
+	std::printf("%-20s %14s %14lld %14.0f\n", "total", "", all, all / elapsed.count());
+
+	long long violations = shadow.violations.load();
+	if (violations) {
+		std::printf("%lld invariant violations, first: %s\n", violations, shadow.firstViolation.c_str());
+		return 1;
+	}
+	std::printf("no invariant violations\n");
+	return 0;
+}
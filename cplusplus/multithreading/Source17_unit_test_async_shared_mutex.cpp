@@ -0,0 +1,270 @@
+#include "AsyncSharedMutex.h"
+#include "Executors.h"
+#include <atomic>
+#include <latch>
+#include <cassert>
+#include <exception>
+#include <pthread.h>
+
+// Fire-and-forget coroutine: starts eagerly, frame destroyed on completion.
+struct Task
+{
+	struct promise_type
+	{
+		Task get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+Task lockReader(AsyncSharedMutex &m, ManualExecutor &executor, bool &acquired)
+{
+	co_await executor.schedule();
+	co_await m.lock_shared_async();
+	acquired = true;
+}
+
+Task lockWriter(AsyncSharedMutex &m, ManualExecutor &executor, bool &acquired)
+{
+	co_await executor.schedule();
+	co_await m.lock_async();
+	acquired = true;
+}
+
+void test_0readers0writers_lockWriter()
+{
+	AsyncSharedMutex m;
+	ManualExecutor executor;
+
+	// + lock writer
+	bool writerAcquired = false;
+	lockWriter(m, executor, writerAcquired);
+	executor.run();
+
+	// = lock acquired without suspending
+	assert(writerAcquired == true);
+	m.unlock();
+}
+
+void test_0readers1writer_lockReader()
+{
+	AsyncSharedMutex m;
+	ManualExecutor executor;
+
+	// 1 writer
+	bool writerAcquired = false;
+	lockWriter(m, executor, writerAcquired);
+	executor.run();
+	assert(writerAcquired == true);
+
+	// + lock 2 readers
+	bool reader1Acquired = false;
+	bool reader2Acquired = false;
+	lockReader(m, executor, reader1Acquired);
+	lockReader(m, executor, reader2Acquired);
+	executor.run();
+
+	// = readers suspended, executor not blocked
+	assert(reader1Acquired == false);
+	assert(reader2Acquired == false);
+
+	// + unlock writer
+	m.unlock();
+
+	// = both readers resumed holding the lock
+	assert(reader1Acquired == true);
+	assert(reader2Acquired == true);
+	m.shared_unlock();
+	m.shared_unlock();
+}
+
+void test_2readers0writers_lockWriter()
+{
+	AsyncSharedMutex m;
+	ManualExecutor executor;
+
+	// 2 readers
+	bool reader1Acquired = false;
+	bool reader2Acquired = false;
+	lockReader(m, executor, reader1Acquired);
+	lockReader(m, executor, reader2Acquired);
+	executor.run();
+	assert(reader1Acquired == true);
+	assert(reader2Acquired == true);
+
+	// + lock writer
+	bool writerAcquired = false;
+	lockWriter(m, executor, writerAcquired);
+	executor.run();
+	assert(writerAcquired == false);
+
+	// + unlock one reader
+	m.shared_unlock();
+
+	// = writer still suspended
+	assert(writerAcquired == false);
+
+	// + unlock other reader
+	m.shared_unlock();
+
+	// = writer resumed holding the lock
+	assert(writerAcquired == true);
+	m.unlock();
+}
+
+void test_0readers1writer_lockWriter()
+{
+	AsyncSharedMutex m;
+	ManualExecutor executor;
+
+	// 1 writer
+	bool writer1Acquired = false;
+	lockWriter(m, executor, writer1Acquired);
+	executor.run();
+	assert(writer1Acquired == true);
+
+	// + lock 2 more writers
+	bool writer2Acquired = false;
+	bool writer3Acquired = false;
+	lockWriter(m, executor, writer2Acquired);
+	lockWriter(m, executor, writer3Acquired);
+	executor.run();
+	assert(writer2Acquired == false);
+	assert(writer3Acquired == false);
+
+	// + unlock writer
+	m.unlock();
+
+	// = only the first waiting writer is resumed
+	assert(writer2Acquired == true);
+	assert(writer3Acquired == false);
+	m.unlock();
+	assert(writer3Acquired == true);
+	m.unlock();
+}
+
+void test_unlockNotLocked()
+{
+	AsyncSharedMutex m;
+
+	bool writerException = false;
+	try {
+		m.unlock();
+	}
+	catch (std::logic_error &) {
+		writerException = true;
+	}
+
+	bool readerException = false;
+	try {
+		m.shared_unlock();
+	}
+	catch (std::logic_error &) {
+		readerException = true;
+	}
+
+	assert(writerException == true);
+	assert(readerException == true);
+}
+
+Task lockWriterAndUnlock(AsyncSharedMutex &m, int &acquired)
+{
+	co_await m.lock_async();
+	acquired++;
+	m.unlock();
+}
+
+// Runs f on a thread with a 256 KiB stack, so that nesting a frame per
+// waiter overflows it whatever the optimization level.
+template<class F>
+void onSmallStack(F f)
+{
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, 256 * 1024);
+	pthread_t thread;
+	int result = pthread_create(&thread, &attr, [](void *arg) -> void * {
+		(*(F *)arg)();
+		return nullptr;
+	}, &f);
+	assert(result == 0);
+	(void)result;
+	pthread_join(thread, nullptr);
+	pthread_attr_destroy(&attr);
+}
+
+void test_1writer100000waitingWriters_unlockWriter()
+{
+	onSmallStack([] {
+		const int nWriters = 100000;
+
+		AsyncSharedMutex m;
+		ManualExecutor executor;
+
+		// 1 writer
+		bool writerAcquired = false;
+		lockWriter(m, executor, writerAcquired);
+		executor.run();
+
+		// + lock 100000 writers, each unlocking as soon as it acquires
+		int acquired = 0;
+		for (int i = 0; i < nWriters; i++)
+			lockWriterAndUnlock(m, acquired);
+		assert(acquired == 0);
+
+		// + unlock writer
+		m.unlock();
+
+		// = all resumed one after the other, without a stack frame per writer
+		assert(acquired == nWriters);
+	});
+}
+
+Task increment(AsyncSharedMutex &m, ThreadPoolExecutor &pool, int i, int &counter, std::atomic<int> &observedWriters, std::latch &done)
+{
+	co_await pool.schedule();
+	if (i % 3 == 0) {
+		co_await m.lock_shared_async();
+		assert(observedWriters == 0);
+		m.shared_unlock();
+	}
+	co_await m.lock_async();
+	int writersBefore = observedWriters.fetch_add(1);
+	assert(writersBefore == 0);
+	counter++;
+	observedWriters.fetch_sub(1);
+	m.unlock();
+	done.count_down();
+}
+
+void test_threadPool_writersExclusive()
+{
+	const int nTasks = 2000;
+
+	AsyncSharedMutex m;
+	int counter = 0;
+	std::atomic<int> observedWriters{0};
+	std::latch done(nTasks);
+	{
+		ThreadPoolExecutor pool(4);
+		for (int i = 0; i < nTasks; i++)
+			increment(m, pool, i, counter, observedWriters, done);
+		done.wait();
+	}
+
+	assert(counter == nTasks);
+}
+
+int main()
+{
+	test_0readers0writers_lockWriter();
+	test_0readers1writer_lockReader();
+	test_2readers0writers_lockWriter();
+	test_0readers1writer_lockWriter();
+	test_unlockNotLocked();
+	test_1writer100000waitingWriters_unlockWriter();
+	test_threadPool_writersExclusive();
+	return 0;
+}
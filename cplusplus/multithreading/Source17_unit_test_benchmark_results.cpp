@@ -0,0 +1,168 @@
+#include "BenchmarkResults.h"
+#include <cmath>
+#include <sstream>
+#include <cassert>
+
+using namespace benchmark_results;
+
+bool near(double a, double b)
+{
+	return std::fabs(a - b) < 1e-9;
+}
+
+void test_mannWhitney_separatedSamples_exactP()
+{
+	// U = 0 is 1 of the 20 equally likely orderings at each end
+	MannWhitney test = mann_whitney({1, 2, 3}, {4, 5, 6});
+	assert(near(test.u, 0));
+	assert(near(test.p, 0.1));
+}
+
+void test_mannWhitney_interleavedSamples_notSignificant()
+{
+	// U = 3; P(U <= 3) = 7/20 for 3 and 3 samples
+	MannWhitney test = mann_whitney({1, 3, 5}, {2, 4, 6});
+	assert(near(test.u, 3));
+	assert(near(test.p, 0.7));
+}
+
+void test_mannWhitney_allTied_pIsOne()
+{
+	MannWhitney test = mann_whitney({7, 7, 7, 7}, {7, 7, 7, 7});
+	assert(near(test.u, 8));
+	assert(near(test.p, 1));
+}
+
+void test_mannWhitney_largeSamples_normalApproximation()
+{
+	std::vector<double> a, b;
+	for (int i = 0; i < 30; i++) {
+		a.push_back(i);
+		b.push_back(i + 20);
+	}
+	MannWhitney test = mann_whitney(a, b);
+	assert(test.p < 1e-4);
+	assert(mann_whitney(a, a).p > 0.9);
+}
+
+void test_results_jsonRoundTrip()
+{
+	Results results;
+	results.timestamp = "2026-01-02T03:04:05Z";
+	results.machine.cpu = "CPU \"quoted\" \\ model";
+	results.machine.cores = 8;
+	results.machine.kernel = "Linux 6.1 x86_64";
+	results.machine.compiler = "gcc 12";
+	results.machine.flags = "Release -O3";
+	results.add("throughput/SharedMutex/threads=1", "ops/s", true, 123456789.125);
+	results.add("throughput/SharedMutex/threads=1", "ops/s", true, 0.1);
+	results.add("fastpath/SharedMutex/lock+unlock", "ns", false, 12.5);
+
+	std::stringstream json;
+	results.write_json(json);
+	Results read = Results::read_json(json);
+
+	assert(read.timestamp == results.timestamp);
+	assert(read.machine.cpu == results.machine.cpu);
+	assert(read.machine.cores == 8);
+	assert(read.machine.flags == "Release -O3");
+	assert(read.series.size() == 2);
+	const Series *throughput = read.find("throughput/SharedMutex/threads=1");
+	assert(throughput && throughput->higherIsBetter && throughput->unit == "ops/s");
+	assert(throughput->samples == std::vector<double>({123456789.125, 0.1}));
+	const Series *fastPath = read.find("fastpath/SharedMutex/lock+unlock");
+	assert(fastPath && !fastPath->higherIsBetter && fastPath->samples.size() == 1);
+}
+
+void test_results_malformedJson_throws()
+{
+	std::stringstream json("{\"series\": [{\"name\": \"x\", \"samples\": [1, 2}]}");
+	bool thrown = false;
+	try {
+		Results::read_json(json);
+	}
+	catch (const std::runtime_error &) {
+		thrown = true;
+	}
+	assert(thrown);
+}
+
+void test_compare_flagsSignificantChangesAboveThreshold()
+{
+	Results baseline, candidate;
+	for (double x : {100, 101, 102, 103, 104}) {
+		baseline.add("ops", "ops/s", true, x);
+		candidate.add("ops", "ops/s", true, x - 20);          // 20% slower
+		baseline.add("latency", "ns", false, x);
+		candidate.add("latency", "ns", false, x - 20);        // 20% faster
+		baseline.add("small", "ops/s", true, x);
+		candidate.add("small", "ops/s", true, x - 2);         // significant, below threshold
+		baseline.add("noisy", "ops/s", true, x);
+		candidate.add("noisy", "ops/s", true, x == 100 ? 50 : x + 40);   // large but not significant
+	}
+
+	std::vector<Comparison> comparisons = compare(baseline, candidate, 5, 0.05);
+	assert(comparisons.size() == 4);
+	assert(comparisons[0].name == "ops" && comparisons[0].verdict == Verdict::regressed);
+	assert(near(comparisons[0].change, -20 / 102.0 * 100));
+	assert(comparisons[1].name == "latency" && comparisons[1].verdict == Verdict::improved);
+	assert(comparisons[1].change > 0);
+	assert(comparisons[2].verdict == Verdict::unchanged);
+	assert(comparisons[3].verdict == Verdict::unchanged);
+}
+
+void test_compare_tooFewSamples_inconclusive()
+{
+	// 3 samples per side reach p = 0.1 at best, 4 reach 2/70
+	assert(near(minimum_p(3, 3), 0.1));
+	assert(near(minimum_p(4, 4), 2 / 70.0));
+	assert(minimum_p(1, 1) >= 0.05);
+
+	Results baseline, candidate;
+	for (double x : {100, 101, 102}) {
+		baseline.add("three", "ops/s", true, x);
+		candidate.add("three", "ops/s", true, x / 2);      // 50% slower, not detectable
+	}
+	for (double x : {100, 101, 102, 103}) {
+		baseline.add("four", "ops/s", true, x);
+		candidate.add("four", "ops/s", true, x / 2);
+	}
+
+	std::vector<Comparison> comparisons = compare(baseline, candidate, 5, 0.05);
+	assert(comparisons[0].verdict == Verdict::inconclusive);
+	assert(comparisons[1].verdict == Verdict::regressed);
+}
+
+void test_compare_seriesInOneRun_reported()
+{
+	Results baseline, candidate;
+	for (double x : {100, 101, 102, 103}) {
+		baseline.add("both", "ops/s", true, x);
+		candidate.add("both", "ops/s", true, x);
+		baseline.add("only in baseline", "ops/s", true, x);
+		candidate.add("only in candidate", "ns", false, x);
+	}
+
+	// = listed with the run that has them, not dropped
+	std::vector<Comparison> comparisons = compare(baseline, candidate, 5, 0.05);
+	assert(comparisons.size() == 3);
+	assert(comparisons[0].name == "both" && comparisons[0].verdict == Verdict::unchanged);
+	assert(comparisons[1].name == "only in baseline" && comparisons[1].verdict == Verdict::missing);
+	assert(near(comparisons[1].baseline, 101.5) && std::isnan(comparisons[1].candidate));
+	assert(comparisons[2].name == "only in candidate" && comparisons[2].verdict == Verdict::added);
+	assert(std::isnan(comparisons[2].baseline) && near(comparisons[2].candidate, 101.5));
+}
+
+int main()
+{
+	test_mannWhitney_separatedSamples_exactP();
+	test_mannWhitney_interleavedSamples_notSignificant();
+	test_mannWhitney_allTied_pIsOne();
+	test_mannWhitney_largeSamples_normalApproximation();
+	test_results_jsonRoundTrip();
+	test_results_malformedJson_throws();
+	test_compare_flagsSignificantChangesAboveThreshold();
+	test_compare_tooFewSamples_inconclusive();
+	test_compare_seriesInOneRun_reported();
+	return 0;
+}
@@ -0,0 +1,97 @@
+#include "ElidedSharedMutex.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+#include <utility>
+#include <cassert>
+
+// Each slot holds a pair that writers always keep equal. Read sections copy a
+// pair out and the test checks that no torn pair ever escapes read(). The
+// halves are relaxed atomics, as read() requires of data it races with.
+struct Slot
+{
+	std::atomic<int> first{0};
+	std::atomic<int> second{0};
+};
+
+void test_write_returnsValue()
+{
+	ElidedSharedMutex m;
+	int value = 0;
+
+	int result = m.write([&] { return std::atomic_ref<int>(value).fetch_add(1, std::memory_order_relaxed) + 1; });
+
+	assert(result == 1);
+	assert(m.read([&] { return std::atomic_ref<int>(value).load(std::memory_order_relaxed); }) == 1);
+}
+
+void test_write_exceptionReleasesLock()
+{
+	ElidedSharedMutex m;
+	bool thrown = false;
+
+	try {
+		m.write([] { throw std::runtime_error("section failed"); });
+	}
+	catch (std::runtime_error &) {
+		thrown = true;
+	}
+
+	// = lock released, next section runs
+	assert(thrown == true);
+	assert(m.write([] { return 42; }) == 42);
+}
+
+void test_disjointWriters_readersSeeConsistentPairs()
+{
+	const int nWriters = 4;
+	const int nReaders = 4;
+	const int iterations = 20000;
+
+	ElidedSharedMutex m;
+	std::vector<Slot> slots(nWriters);
+	std::atomic<bool> torn{false};
+
+	std::vector<std::thread> threads;
+	for (int w = 0; w < nWriters; w++) {
+		threads.emplace_back([&, w] {
+			for (int i = 1; i <= iterations; i++) {
+				m.write([&] {
+					slots[w].first.store(i, std::memory_order_relaxed);
+					slots[w].second.store(i, std::memory_order_relaxed);
+				});
+			}
+		});
+	}
+	for (int r = 0; r < nReaders; r++) {
+		threads.emplace_back([&, r] {
+			for (int i = 0; i < iterations; i++) {
+				Slot &slot = slots[(r + i) % nWriters];
+				std::pair<int, int> pair = m.read([&] {
+					return std::make_pair(slot.first.load(std::memory_order_relaxed),
+										  slot.second.load(std::memory_order_relaxed));
+				});
+				if (pair.first != pair.second)
+					torn = true;
+			}
+		});
+	}
+	for (auto &t : threads)
+		t.join();
+
+	// = every writer applied all updates, no torn pair observed
+	assert(torn == false);
+	for (auto &slot : slots) {
+		assert(slot.first == iterations);
+		assert(slot.second == iterations);
+	}
+}
+
+int main()
+{
+	test_write_returnsValue();
+	test_write_exceptionReleasesLock();
+	test_disjointWriters_readersSeeConsistentPairs();
+	return 0;
+}
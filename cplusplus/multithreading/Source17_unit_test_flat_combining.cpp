@@ -0,0 +1,116 @@
+#include "FlatCombiningSharedMutex.h"
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+#include <cassert>
+
+void test_combine_exceptionPropagatesToCaller()
+{
+	FlatCombiningSharedMutex m;
+	bool thrown = false;
+
+	try {
+		m.combine([] { throw std::runtime_error("section failed"); });
+	}
+	catch (std::runtime_error &) {
+		thrown = true;
+	}
+
+	// = exception rethrown, lock released
+	assert(thrown == true);
+	m.lock();
+	m.unlock();
+}
+
+void test_concurrentWriters_noLostUpdates()
+{
+	const int nWriters = 16;
+	const int iterations = 5000;
+
+	FlatCombiningSharedMutex m;
+	long long counter = 0;
+	long long sum = 0;
+
+	std::vector<std::thread> threads;
+	for (int w = 0; w < nWriters; w++) {
+		threads.emplace_back([&, w] {
+			for (int i = 0; i < iterations; i++)
+				m.combine([&] { counter++; sum += w; });
+		});
+	}
+	for (auto &t : threads)
+		t.join();
+
+	// = every section applied exactly once
+	assert(counter == (long long)nWriters * iterations);
+	assert(sum == (long long)iterations * nWriters * (nWriters - 1) / 2);
+}
+
+void test_moreWritersThanSlots_noLostUpdates()
+{
+	// twice the 128 publication slots, so writers find every slot taken
+	const int nWriters = 256;
+	const int iterations = 200;
+
+	FlatCombiningSharedMutex m;
+	long long counter = 0;
+
+	std::vector<std::thread> threads;
+	for (int w = 0; w < nWriters; w++) {
+		threads.emplace_back([&] {
+			for (int i = 0; i < iterations; i++)
+				m.combine([&] { counter++; });
+		});
+	}
+	for (auto &t : threads)
+		t.join();
+
+	assert(counter == (long long)nWriters * iterations);
+}
+
+void test_readersExcludedFromCombinedSections()
+{
+	const int nWriters = 4;
+	const int nReaders = 4;
+	const int iterations = 5000;
+
+	FlatCombiningSharedMutex m;
+	int first = 0;
+	int second = 0;
+	std::atomic<bool> torn{false};
+
+	std::vector<std::thread> threads;
+	for (int w = 0; w < nWriters; w++) {
+		threads.emplace_back([&] {
+			for (int i = 0; i < iterations; i++)
+				m.combine([&] { first++; second++; });
+		});
+	}
+	for (int r = 0; r < nReaders; r++) {
+		threads.emplace_back([&] {
+			for (int i = 0; i < iterations; i++) {
+				m.shared_lock();
+				bool equal = first == second;
+				m.shared_unlock();
+				if (!equal)
+					torn = true;
+			}
+		});
+	}
+	for (auto &t : threads)
+		t.join();
+
+	// = readers never saw a half-applied section
+	assert(torn == false);
+	assert(first == nWriters * iterations);
+}
+
+int main()
+{
+	test_combine_exceptionPropagatesToCaller();
+	test_concurrentWriters_noLostUpdates();
+	test_moreWritersThanSlots_noLostUpdates();
+	test_readersExcludedFromCombinedSections();
+	return 0;
+}
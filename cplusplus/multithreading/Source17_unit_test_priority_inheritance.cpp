@@ -0,0 +1,423 @@
+#define SHARED_MUTEX_TRACE
+#include "PriorityInheritanceSharedMutex.h"
+#include "SharedMutexTestHarness.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <cassert>
+
+using namespace std::chrono_literals;
+
+ThreadHarness harness;
+
+// Makes the calling thread SCHED_FIFO at `priority`, pinned to the first CPU
+// it may run on, so that priorities alone decide who runs. Returns false if
+// the process may not use real-time scheduling.
+bool runRealtime(int priority)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) != 0)
+		return false;
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &set)) {
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			break;
+		}
+	}
+	sched_param param{};
+	param.sched_priority = priority;
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 &&
+		pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+void runNormal()
+{
+	sched_param param{};
+	pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+}
+
+bool realtimeAllowed()
+{
+	bool allowed = false;
+	std::thread probe([&] { allowed = runRealtime(1); });
+	probe.join();
+	if (!allowed)
+		std::printf("skipped: SCHED_FIFO not permitted\n");
+	return allowed;
+}
+
+void busyFor(std::chrono::milliseconds duration)
+{
+	auto end = std::chrono::steady_clock::now() + duration;
+	while (std::chrono::steady_clock::now() < end)
+		;
+}
+
+void test_uncontended_lockSharedLockTryLock()
+{
+	PriorityInheritanceSharedMutex m;
+
+	m.lock();
+	assert(m.try_shared_lock() == false);
+	m.unlock();
+
+	m.shared_lock();
+	m.shared_lock();
+	assert(m.try_lock() == false);
+	m.shared_unlock();
+	m.shared_unlock();
+
+	assert(m.try_lock() == true);
+	m.unlock();
+	assert(m.try_shared_lock() == true);
+	m.shared_unlock();
+}
+
+void test_notLocked_unlockThrows()
+{
+	PriorityInheritanceSharedMutex m;
+	bool thrown = false;
+	try {
+		m.unlock();
+	}
+	catch (const std::logic_error &) {
+		thrown = true;
+	}
+	assert(thrown);
+
+	thrown = false;
+	try {
+		m.shared_unlock();
+	}
+	catch (const std::logic_error &) {
+		thrown = true;
+	}
+	assert(thrown);
+}
+
+void test_lockTwice_deadlockDetected()
+{
+	PriorityInheritanceSharedMutex m;
+	m.lock();
+	bool thrown = false;
+	try {
+		m.lock();
+	}
+	catch (const std::system_error &) {
+		thrown = true;
+	}
+	assert(thrown);
+	m.unlock();
+	assert(m.try_lock() == true);
+	m.unlock();
+}
+
+void test_1reader_blockedWriter_nestedSharedLock()
+{
+	PriorityInheritanceSharedMutex m;
+	std::atomic<bool> holds{false};
+	std::atomic<bool> release{false};
+	std::atomic<bool> nested{false};
+	std::atomic<bool> written{false};
+
+	// not spawned through the harness: settle() would wait for it to block
+	std::thread reader([&] {
+		m.shared_lock();
+		holds = true;
+		while (!release)
+			std::this_thread::yield();
+		// a writer now waits on this reader's slot
+		m.shared_lock();
+		nested = true;
+		m.shared_unlock();
+		m.shared_unlock();
+	});
+	while (!holds)
+		std::this_thread::yield();
+
+	std::thread writer = harness.spawn([&] {
+		m.lock();
+		written = true;
+		m.unlock();
+	});
+	harness.settle();
+	assert(written == false);
+
+	// = nested shared lock granted, then the writer
+	release = true;
+	reader.join();
+	writer.join();
+	assert(nested && written);
+}
+
+void test_manyReaders_writerWaitsForSlotless()
+{
+	// more readers than slots, so some are counted without one
+	const int nReaders = 48;
+	PriorityInheritanceSharedMutex m;
+	std::atomic<int> inside{0};
+	std::atomic<bool> release{false};
+	std::atomic<bool> written{false};
+
+	std::vector<std::thread> readers;
+	for (int i = 0; i < nReaders; i++) {
+		readers.emplace_back([&] {
+			m.shared_lock();
+			inside++;
+			while (!release)
+				std::this_thread::yield();
+			inside--;
+			m.shared_unlock();
+		});
+	}
+	while (inside != nReaders)
+		std::this_thread::yield();
+
+	std::thread writer = harness.spawn([&] {
+		m.lock();
+		assert(inside == 0);
+		written = true;
+		m.unlock();
+	});
+	harness.settle();
+	assert(written == false);
+
+	release = true;
+	for (auto &t : readers)
+		t.join();
+	writer.join();
+	assert(written);
+}
+
+void test_manyReaders_blockedWriter_nestedSharedLock()
+{
+	// more readers than slots: those counted without one must not queue
+	// behind the writer either
+	const int nReaders = 40;
+	PriorityInheritanceSharedMutex m;
+	std::atomic<int> inside{0};
+	std::atomic<int> nested{0};
+	std::atomic<int> refused{0};
+	std::atomic<bool> nest{false};
+	std::atomic<bool> release{false};
+	std::atomic<bool> written{false};
+
+	std::vector<std::thread> readers;
+	for (int i = 0; i < nReaders; i++) {
+		readers.emplace_back([&] {
+			m.shared_lock();
+			inside++;
+			while (!nest)
+				std::this_thread::yield();
+			m.shared_lock();
+			nested++;
+			try {
+				m.lock();
+			}
+			catch (const std::system_error &) {
+				refused++;
+			}
+			m.shared_unlock();
+			while (!release)
+				std::this_thread::yield();
+			m.shared_unlock();
+		});
+	}
+	while (inside != nReaders)
+		std::this_thread::yield();
+
+	std::thread writer = harness.spawn([&] {
+		m.lock();
+		written = true;
+		m.unlock();
+	});
+	harness.settle();
+
+	// = every nested shared lock granted and every upgrade refused while the
+	// writer waits
+	nest = true;
+	while (nested != nReaders || refused != nReaders)
+		std::this_thread::yield();
+	assert(written == false);
+
+	release = true;
+	for (auto &t : readers)
+		t.join();
+	writer.join();
+	assert(written);
+}
+
+void test_niceThreads_mutualExclusion()
+{
+	// unprivileged threads may only lower their priority; the kernel serves
+	// them first come, first served, but every path still runs through PI futexes
+	PriorityInheritanceSharedMutex m;
+	std::atomic<int> writers{0};
+	std::atomic<int> readers{0};
+	long long writes = 0;
+	const int nices[] = {0, 5, 10, 19, 0, 5, 10, 19};
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 8; t++) {
+		threads.emplace_back([&, t] {
+			setpriority(PRIO_PROCESS, 0, nices[t]);
+			for (int i = 0; i < 2000; i++) {
+				if ((t + i) % 4 == 0) {
+					m.lock();
+					assert(++writers == 1 && readers == 0);
+					writes++;
+					writers--;
+					m.unlock();
+				}
+				else {
+					m.shared_lock();
+					readers++;
+					assert(writers == 0);
+					readers--;
+					m.shared_unlock();
+				}
+			}
+		});
+	}
+	for (auto &t : threads)
+		t.join();
+	assert(writes == 8 * 2000 / 4);
+}
+
+void test_fifo_waitersAdmittedInPriorityOrder()
+{
+	if (!realtimeAllowed())
+		return;
+	PriorityInheritanceSharedMutex m;
+	std::mutex orderMutex;
+	std::vector<int> order;
+	bool realtime = runRealtime(50);
+	assert(realtime);
+	m.lock();
+
+	std::vector<std::thread> threads;
+	const int priorities[] = {10, 30, 20, 40};
+	for (int priority : priorities) {
+		threads.push_back(harness.spawn([&, priority] {
+			runRealtime(priority);
+			// odd tens are readers: they queue on the same gate as writers
+			bool reader = priority / 10 % 2 == 1;
+			if (reader)
+				m.shared_lock();
+			else
+				m.lock();
+			{
+				std::unique_lock<std::mutex> lock(orderMutex);
+				order.push_back(priority);
+			}
+			if (reader)
+				m.shared_unlock();
+			else
+				m.unlock();
+		}));
+		harness.settle();
+	}
+
+	m.unlock();
+	for (auto &t : threads)
+		t.join();
+	runNormal();
+	assert(order == std::vector<int>({40, 30, 20, 10}));
+}
+
+// Low takes the lock and needs 50 ms of CPU to finish; high then blocks on it
+// and medium starts 200 ms of busy work. On one CPU, low can only finish
+// before medium if it inherits high's priority.
+void inversion(bool lowTakesShared)
+{
+	PriorityInheritanceSharedMutex m;
+	std::atomic<bool> lowHolds{false};
+	std::atomic<bool> highWaits{false};
+	std::atomic<bool> highAcquired{false};
+	std::atomic<bool> highBeforeMediumDone{false};
+	bool realtime = runRealtime(90);
+	assert(realtime);
+
+	std::thread low([&] {
+		runRealtime(10);
+		if (lowTakesShared)
+			m.shared_lock();
+		else
+			m.lock();
+		lowHolds = true;
+		timespec begin, now;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &begin);
+		do
+			clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+		while ((now.tv_sec - begin.tv_sec) * 1000000000ll + (now.tv_nsec - begin.tv_nsec) < 50000000);
+		if (lowTakesShared)
+			m.shared_unlock();
+		else
+			m.unlock();
+	});
+	while (!lowHolds)
+		std::this_thread::sleep_for(1ms);
+
+	std::thread high([&] {
+		runRealtime(30);
+		highWaits = true;
+		if (lowTakesShared)
+			m.lock();
+		else
+			m.shared_lock();
+		highAcquired = true;
+		if (lowTakesShared)
+			m.unlock();
+		else
+			m.shared_unlock();
+	});
+	while (!highWaits)
+		std::this_thread::sleep_for(1ms);
+	std::this_thread::sleep_for(1ms);
+
+	std::thread medium([&] {
+		runRealtime(20);
+		busyFor(200ms);
+		highBeforeMediumDone = highAcquired.load();
+	});
+	medium.join();
+	high.join();
+	low.join();
+	runNormal();
+	assert(highBeforeMediumDone);
+}
+
+void test_fifo_writerBlockedByReader_readerBoosted()
+{
+	if (realtimeAllowed())
+		inversion(true);
+}
+
+void test_fifo_readerBlockedByWriter_writerBoosted()
+{
+	if (realtimeAllowed())
+		inversion(false);
+}
+
+int main()
+{
+	test_uncontended_lockSharedLockTryLock();
+	test_notLocked_unlockThrows();
+	test_lockTwice_deadlockDetected();
+	test_1reader_blockedWriter_nestedSharedLock();
+	test_manyReaders_writerWaitsForSlotless();
+	test_manyReaders_blockedWriter_nestedSharedLock();
+	test_niceThreads_mutualExclusion();
+	test_fifo_waitersAdmittedInPriorityOrder();
+	test_fifo_writerBlockedByReader_readerBoosted();
+	test_fifo_readerBlockedByWriter_writerBoosted();
+	return 0;
+}
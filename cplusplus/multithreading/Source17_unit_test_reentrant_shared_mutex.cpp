@@ -0,0 +1,186 @@
+#define SHARED_MUTEX_TRACE
+#include "ReentrantSharedMutex.h"
+#include "SharedMutexTestHarness.h"
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <cassert>
+
+ThreadHarness harness;
+
+// Returns the result of f run on another thread.
+template<class F>
+bool onOtherThread(F f)
+{
+	bool result = false;
+	std::thread other([&] { result = f(); });
+	other.join();
+	return result;
+}
+
+// Returns the logic_error message f threw, or an empty string.
+template<class F>
+std::string logicError(F f)
+{
+	try {
+		f();
+	}
+	catch (const std::logic_error &e) {
+		return e.what();
+	}
+	return "";
+}
+
+void test_1reader_nestedSharedLock()
+{
+	ReentrantSharedMutex m;
+
+	// 1 reader
+	m.shared_lock();
+
+	// + lock reader twice more on the same thread
+	m.shared_lock();
+	assert(m.try_shared_lock() == true);
+
+	// = held until the outermost release
+	m.shared_unlock();
+	m.shared_unlock();
+	assert(onOtherThread([&] { return m.try_lock(); }) == false);
+	m.shared_unlock();
+	assert(m.try_lock() == true);
+	m.unlock();
+}
+
+void test_1writer_nestedLock()
+{
+	ReentrantSharedMutex m;
+
+	// 1 writer
+	m.lock();
+
+	// + lock writer again on the same thread
+	m.lock();
+	assert(m.try_lock() == true);
+
+	// = other threads kept out until the outermost release
+	m.unlock();
+	m.unlock();
+	assert(onOtherThread([&] { return m.try_shared_lock(); }) == false);
+	m.unlock();
+	assert(onOtherThread([&] {
+		bool locked = m.try_shared_lock();
+		m.shared_unlock();
+		return locked;
+	}) == true);
+}
+
+void test_1writer_nestedSharedLock()
+{
+	ReentrantSharedMutex m;
+
+	// 1 writer
+	m.lock();
+
+	// + lock reader on the same thread, twice
+	m.shared_lock();
+	assert(m.try_shared_lock() == true);
+
+	// = writer released only after the nested reads
+	assert(logicError([&] { m.unlock(); }).find("still held") != std::string::npos);
+	m.shared_unlock();
+	m.shared_unlock();
+	assert(onOtherThread([&] { return m.try_shared_lock(); }) == false);
+	m.unlock();
+	assert(m.try_lock() == true);
+	m.unlock();
+}
+
+void test_1reader_lockWriter_upgradeThrows()
+{
+	ReentrantSharedMutex m;
+
+	// 1 reader
+	m.shared_lock();
+
+	// + lock writer on the same thread
+	// = refused instead of deadlocking, reader still held
+	assert(logicError([&] { m.lock(); }).find("would deadlock") != std::string::npos);
+	assert(m.try_lock() == false);
+	assert(onOtherThread([&] { return m.try_lock(); }) == false);
+	m.shared_unlock();
+	assert(m.try_lock() == true);
+	m.unlock();
+}
+
+void test_0readers0writers_unlockThrows()
+{
+	ReentrantSharedMutex m;
+	assert(logicError([&] { m.unlock(); }) == "not locked");
+	assert(logicError([&] { m.shared_unlock(); }) == "not locked");
+
+	// + unlock writer from another thread
+	m.lock();
+	assert(onOtherThread([&] { return logicError([&] { m.unlock(); }) == "not locked"; }));
+	m.unlock();
+}
+
+void test_1reader_blockedWriter_nestedSharedLock()
+{
+	ReentrantSharedMutex m;
+
+	// 1 reader, 1 blocked writer
+	m.shared_lock();
+	std::atomic<bool> written{false};
+	std::thread writer = harness.spawn([&] {
+		m.lock();
+		written = true;
+		m.unlock();
+	});
+	harness.settle();
+	assert(written == false);
+
+	// + lock reader again on the reader's thread
+	// = granted without queueing behind the writer
+	m.shared_lock();
+	m.shared_unlock();
+	m.shared_unlock();
+	writer.join();
+	assert(written == true);
+}
+
+void test_2locks_releasedOutOfOrder()
+{
+	ReentrantSharedMutex a;
+	ReentrantSharedMutex b;
+
+	a.shared_lock();
+	b.shared_lock();
+	a.shared_lock();
+
+	// + release a, the deeper entry, before b
+	a.shared_unlock();
+	a.shared_unlock();
+	assert(a.try_lock() == true);
+	a.unlock();
+
+	// = b still tracked and released once
+	b.shared_lock();
+	b.shared_unlock();
+	assert(onOtherThread([&] { return b.try_lock(); }) == false);
+	b.shared_unlock();
+	assert(b.try_lock() == true);
+	b.unlock();
+}
+
+int main()
+{
+	test_1reader_nestedSharedLock();
+	test_1writer_nestedLock();
+	test_1writer_nestedSharedLock();
+	test_1reader_lockWriter_upgradeThrows();
+	test_0readers0writers_unlockThrows();
+	test_1reader_blockedWriter_nestedSharedLock();
+	test_2locks_releasedOutOfOrder();
+	return 0;
+}
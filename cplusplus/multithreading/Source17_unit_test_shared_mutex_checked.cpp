@@ -0,0 +1,148 @@
+#define SHARED_MUTEX_CHECKED
+#define SHARED_MUTEX_TRACE
+#include "SharedMutex.h"
+#include "Executors.h"
+#include "SharedMutexTestHarness.h"
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cassert>
+
+std::vector<std::string> reports;
+ThreadHarness harness;
+
+// Runs f on another thread and returns the logic_error message it threw, or
+// an empty string.
+template<class F>
+std::string errorOnOtherThread(F f)
+{
+	std::string message;
+	std::thread other([&] {
+		try {
+			f();
+		}
+		catch (std::logic_error &e) {
+			message = e.what();
+		}
+	});
+	other.join();
+	return message;
+}
+
+void test_1writer_unlockWriterOtherThread_throws()
+{
+	SharedMutex m;
+
+	// 1 writer on this thread
+	m.lock();
+
+	// + unlock writer from another thread
+	std::string message = errorOnOtherThread([&] { m.unlock(); });
+
+	// = exception naming both sites, lock still held by this thread
+	assert(message.find("does not own the lock") != std::string::npos);
+	assert(message.find(__FILE__) != std::string::npos);
+	m.unlock();
+}
+
+void test_1reader_unlockReaderOtherThread_throws()
+{
+	SharedMutex m;
+
+	// 1 reader on this thread
+	m.shared_lock();
+
+	// + unlock reader from another thread
+	std::string message = errorOnOtherThread([&] { m.shared_unlock(); });
+
+	// = exception, lock still held by this thread
+	assert(message.find("holds no shared lock") != std::string::npos);
+	m.shared_unlock();
+}
+
+void test_0readers0writers_doubleUnlock_throws()
+{
+	SharedMutex m;
+	m.lock();
+	m.unlock();
+
+	std::string message;
+	try {
+		m.unlock();
+	}
+	catch (std::logic_error &e) {
+		message = e.what();
+	}
+
+	assert(message.find("double unlock") != std::string::npos);
+	assert(message.find(__FILE__) != std::string::npos);
+}
+
+void test_1writer_lockReadersOtherThreads_readersOwnTheirLocks()
+{
+	SharedMutex m;
+
+	// 1 writer, 2 readers blocked and batch-admitted on unlock
+	m.lock();
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 2; i++)
+		readers.push_back(harness.spawn([&] {
+			m.shared_lock();
+			m.shared_unlock();
+		}));
+	harness.settle();
+	m.unlock();
+	for (auto &t : readers)
+		t.join();
+
+	// = each reader released its own lock without complaint
+	m.lock();
+	m.unlock();
+}
+
+void test_lockThen_continuationMayUnlockAnywhere()
+{
+	SharedMutex m;
+	ThreadPoolExecutor pool(1);
+	std::atomic<bool> done{false};
+
+	m.lock_then([&] { m.unlock(); done = true; }, pool);
+	while (!done)
+		std::this_thread::yield();
+
+	m.lock();
+	m.unlock();
+}
+
+void test_threadExitsHoldingLock_reported()
+{
+	SharedMutex m;
+
+	std::thread leaker([&] { m.shared_lock(); });
+	leaker.join();
+
+	// = leak reported when the thread exited
+	assert(reports.size() == 1);
+	assert(reports[0].find("thread exited holding") != std::string::npos);
+	assert(reports[0].find(" shared") != std::string::npos);
+	reports.clear();
+}
+
+int main()
+{
+	shared_mutex_debug::set_report_handler([](const std::string &report) { reports.push_back(report); });
+
+	test_1writer_unlockWriterOtherThread_throws();
+	test_1reader_unlockReaderOtherThread_throws();
+	test_0readers0writers_doubleUnlock_throws();
+	test_1writer_lockReadersOtherThreads_readersOwnTheirLocks();
+	test_lockThen_continuationMayUnlockAnywhere();
+	test_threadExitsHoldingLock_reported();
+
+	// = the mutex left locked above was reported when destroyed
+	assert(reports.size() == 1);
+	assert(reports[0].find("destroyed while locked") != std::string::npos);
+	return 0;
+}
@@ -0,0 +1,196 @@
+#include "SharedMutex.h"
+#include "Executors.h"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <cassert>
+
+void test_0readers0writers_lockWriterThen()
+{
+	SharedMutex m;
+	ManualExecutor executor;
+
+	// + lock writer with continuation
+	bool writerRan = false;
+	m.lock_then([&] { writerRan = true; }, executor);
+
+	// = continuation posted, not run inline
+	assert(writerRan == false);
+	assert(executor.run() == 1);
+	assert(writerRan == true);
+	m.unlock();
+}
+
+void test_0readers1writer_lockReaderThen()
+{
+	SharedMutex m;
+	ManualExecutor executor;
+
+	// 1 writer
+	m.lock();
+
+	// + lock 2 readers with continuations
+	bool reader1Ran = false;
+	bool reader2Ran = false;
+	m.lock_shared_then([&] { reader1Ran = true; }, executor);
+	m.lock_shared_then([&] { reader2Ran = true; }, executor);
+
+	// = nothing dispatched while the writer holds the lock
+	assert(executor.run() == 0);
+
+	// + unlock writer
+	m.unlock();
+
+	// = both readers admitted in one phase, writer blocked behind them
+	assert(executor.run() == 2);
+	assert(reader1Ran == true);
+	assert(reader2Ran == true);
+	bool writerRan = false;
+	m.lock_then([&] { writerRan = true; }, executor);
+	assert(executor.run() == 0);
+
+	// + unlock readers
+	m.shared_unlock();
+	assert(executor.run() == 0);
+	m.shared_unlock();
+
+	// = writer admitted
+	assert(executor.run() == 1);
+	assert(writerRan == true);
+	m.unlock();
+}
+
+void test_1reader0writers_lockWriterThen_unlockFromContinuation()
+{
+	SharedMutex m;
+	ManualExecutor executor;
+	int writersRan = 0;
+
+	// 1 reader
+	m.shared_lock();
+
+	// + 2 writers with continuations that release the lock themselves
+	m.lock_then([&] { writersRan++; m.unlock(); }, executor);
+	m.lock_then([&] { writersRan++; m.unlock(); }, executor);
+	assert(executor.run() == 0);
+
+	// + unlock reader
+	m.shared_unlock();
+
+	// = writers run one after another
+	assert(executor.run() == 2);
+	assert(writersRan == 2);
+
+	// = lock free again
+	m.lock();
+	m.unlock();
+}
+
+void test_1writer_lockWriterThen_blockedThreadsCoexist()
+{
+	SharedMutex m;
+	ManualExecutor executor;
+
+	// 1 writer, a blocking reader thread and a writer continuation waiting
+	m.lock();
+	bool readerAcquired = false;
+	std::thread reader([&] { m.shared_lock(); readerAcquired = true; m.shared_unlock(); });
+	bool writerRan = false;
+	m.lock_then([&] { writerRan = true; m.unlock(); }, executor);
+
+	// + unlock writer
+	m.unlock();
+	while (!writerRan) {
+		executor.run();
+		std::this_thread::yield();
+	}
+	reader.join();
+
+	// = both the thread and the continuation got the lock
+	assert(readerAcquired == true);
+	assert(writerRan == true);
+}
+
+// ManualExecutor whose post() throws for the posts numbered in `failing`,
+// like a pool that has been stopped or cannot allocate.
+class FailingExecutor
+{
+	ManualExecutor executor;
+	int posts = 0;
+
+public:
+	std::vector<int> failing;
+
+	void post(std::function<void()> f) {
+		int n = posts++;
+		if (std::find(failing.begin(), failing.end(), n) != failing.end())
+			throw std::runtime_error("post failed");
+		executor.post(std::move(f));
+	}
+
+	int run() {
+		return executor.run();
+	}
+};
+
+template<class F>
+bool throwsPostFailed(F f)
+{
+	try {
+		f();
+	}
+	catch (const std::runtime_error &) {
+		return true;
+	}
+	return false;
+}
+
+void test_0readers0writers_lockWriterThen_postThrows()
+{
+	SharedMutex m;
+	FailingExecutor executor;
+	executor.failing = {0};
+
+	// + lock writer with a continuation that cannot be posted
+	// = exception propagates, lock not left held
+	assert(throwsPostFailed([&] { m.lock_then([] {}, executor); }));
+	assert(throwsPostFailed([&] { m.lock_shared_then([] {}, executor); }) == false);
+	assert(executor.run() == 1);
+	m.shared_unlock();
+	assert(m.try_lock() == true);
+	m.unlock();
+}
+
+void test_1writer3readersThen_unlockWriter_postThrows()
+{
+	SharedMutex m;
+	FailingExecutor executor;
+	executor.failing = {1};
+
+	// 1 writer, 3 reader continuations queued behind it
+	m.lock();
+	int readersRan = 0;
+	for (int i = 0; i < 3; i++)
+		m.lock_shared_then([&] { readersRan++; m.shared_unlock(); }, executor);
+
+	// + unlock writer, the second reader's post throws
+	// = exception propagates after the others are posted, its grant given back
+	assert(throwsPostFailed([&] { m.unlock(); }));
+	assert(executor.run() == 2);
+	assert(readersRan == 2);
+	assert(m.try_lock() == true);
+	m.unlock();
+}
+
+int main()
+{
+	test_0readers0writers_lockWriterThen();
+	test_0readers1writer_lockReaderThen();
+	test_1reader0writers_lockWriterThen_unlockFromContinuation();
+	test_1writer_lockWriterThen_blockedThreadsCoexist();
+	test_0readers0writers_lockWriterThen_postThrows();
+	test_1writer3readersThen_unlockWriter_postThrows();
+	return 0;
+}
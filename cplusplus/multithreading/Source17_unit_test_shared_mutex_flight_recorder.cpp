@@ -0,0 +1,192 @@
+#define SHARED_MUTEX_TRACE
+#include "SharedMutex.h"
+#include "SharedMutexFlightRecorder.h"
+#include "SharedMutexTestHarness.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cassert>
+
+using shared_mutex_trace::flightRecorder;
+
+// Recording starts before the harness is installed, so that the harness passes
+// events on to the recorder. Every thread gets a ring of 64 events.
+const bool recording = [] {
+	flightRecorder().start(64);
+	return true;
+}();
+ThreadHarness harness;
+
+// Clock for tests that need exact times, in nanoseconds.
+std::atomic<std::uint64_t> fakeNow{0};
+
+std::uint64_t fakeClock()
+{
+	return fakeNow.load();
+}
+
+int occurrences(const std::string &text, const std::string &what)
+{
+	int n = 0;
+	for (std::size_t pos = text.find(what); pos != std::string::npos; pos = text.find(what, pos + 1))
+		n++;
+	return n;
+}
+
+std::string dump(std::chrono::nanoseconds window = std::chrono::nanoseconds(0))
+{
+	std::ostringstream os;
+	flightRecorder().write_chrome_trace(os, window);
+	return os.str();
+}
+
+void test_1writer_lockWriter_waitAndHoldSlices()
+{
+	SharedMutex m;
+	flightRecorder().clear();
+
+	m.lock();
+	std::thread writer = harness.spawn([&] {
+		m.lock();
+		m.unlock();
+	});
+	harness.settle();
+	m.unlock();
+	writer.join();
+
+	std::string trace = dump();
+	assert(trace.find("\"traceEvents\"") != std::string::npos);
+	assert(occurrences(trace, "\"wait exclusive\"") == 1);
+	assert(occurrences(trace, "\"hold exclusive\"") == 2);
+	assert(occurrences(trace, "\"thread_name\"") == 2);
+	assert(occurrences(trace, "\"woken writers\": 1") == 1);
+}
+
+void test_releaseOnOtherThread_instantEvent()
+{
+	SharedMutex m;
+	flightRecorder().clear();
+
+	m.shared_lock();
+	std::thread releaser([&] {
+		m.shared_unlock();
+	});
+	releaser.join();
+
+	std::string trace = dump();
+	assert(occurrences(trace, "\"release shared\"") == 1);
+}
+
+void test_window_dropsOlderEvents()
+{
+	SharedMutex m;
+	flightRecorder().clear();
+	flightRecorder().set_clock(&fakeClock);
+
+	// hold exclusive, then 50 ms later hold shared
+	fakeNow = 1000000000;
+	m.lock();
+	m.unlock();
+	fakeNow += 50000000;
+	m.shared_lock();
+	m.shared_unlock();
+
+	// = a 20 ms window keeps only the later hold
+	std::string recent = dump(std::chrono::milliseconds(20));
+	std::string all = dump();
+	flightRecorder().set_clock(nullptr);
+	assert(occurrences(recent, "\"hold shared\"") == 1);
+	assert(occurrences(recent, "\"hold exclusive\"") == 0);
+	assert(occurrences(all, "\"hold shared\"") == 1);
+	assert(occurrences(all, "\"hold exclusive\"") == 1);
+}
+
+void test_ringFull_keepsNewestEvents()
+{
+	SharedMutex m;
+	flightRecorder().clear();
+
+	std::thread worker([&] {
+		for (int i = 0; i < 1000; i++) {
+			m.lock();
+			m.unlock();
+		}
+	});
+	worker.join();
+
+	// 3 events per iteration: the last 64 are a release whose grant was
+	// overwritten and 21 complete holds
+	std::string trace = dump();
+	assert(occurrences(trace, "\"hold exclusive\"") == 21);
+	assert(occurrences(trace, "\"release exclusive\"") == 1);
+}
+
+// Returns the number of "release shared" instant events on fake locks whose
+// fields do not come from one record: each was emitted with lock =
+// (woken + 1) * 64 and equal woken counts.
+const int fakeLocks = 1000;
+
+int tornReleases(const std::string &trace)
+{
+	int torn = 0;
+	const std::string name = "\"release shared\"";
+	for (std::size_t pos = trace.find(name); pos != std::string::npos; pos = trace.find(name, pos + 1)) {
+		std::size_t args = trace.find("\"lock\"", pos);
+		void *lock = nullptr;
+		int readers = -1, writers = -2;
+		if (std::sscanf(trace.c_str() + args, "\"lock\": \"%p\", \"woken readers\": %d, \"woken writers\": %d",
+				&lock, &readers, &writers) != 3)
+			torn++;
+		else if ((std::uintptr_t)lock > fakeLocks * 64)
+			continue;
+		else if (readers != writers || (std::uintptr_t)lock != (std::uintptr_t)(readers + 1) * 64)
+			torn++;
+	}
+	return torn;
+}
+
+void test_dumpWhileRingWraps_noTornEvents()
+{
+	// the writer laps its 64-event ring many times during each dump
+	std::atomic<bool> done{false};
+	std::thread writer([&] {
+		for (int i = 0; !done; i++) {
+			int n = i % fakeLocks;
+			shared_mutex_trace::emit(shared_mutex_trace::Event::release, shared_mutex_trace::Mode::shared,
+				(const void *)((std::uintptr_t)(n + 1) * 64), 0, 0, n, n);
+		}
+	});
+	for (int i = 0; i < 200; i++) {
+		assert(tornReleases(dump()) == 0);
+		std::this_thread::yield();
+	}
+	done = true;
+	writer.join();
+}
+
+void test_stop_noMoreEvents()
+{
+	SharedMutex m;
+
+	flightRecorder().stop();
+	std::string before = dump();
+	m.lock();
+	m.unlock();
+	assert(dump() == before);
+}
+
+int main()
+{
+	test_1writer_lockWriter_waitAndHoldSlices();
+	test_releaseOnOtherThread_instantEvent();
+	test_window_dropsOlderEvents();
+	test_ringFull_keepsNewestEvents();
+	test_dumpWhileRingWraps_noTornEvents();
+	test_stop_noMoreEvents();
+	return 0;
+}
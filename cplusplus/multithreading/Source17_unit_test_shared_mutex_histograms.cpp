@@ -0,0 +1,119 @@
+#define SHARED_MUTEX_HISTOGRAMS
+#define SHARED_MUTEX_TRACE
+#include "SharedMutex.h"
+#include "LatencyHistogram.h"
+#include "SharedMutexTestHarness.h"
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cassert>
+
+ThreadHarness harness;
+
+bool within(std::uint64_t value, std::uint64_t expected, double tolerance)
+{
+	return value >= expected * (1 - tolerance) && value <= expected * (1 + tolerance);
+}
+
+void test_histogram_percentiles()
+{
+	LatencyHistogram h;
+	for (std::uint64_t v = 1; v <= 100000; v++)
+		h.record(v);
+
+	// = percentiles within bucket precision, max exact
+	assert(h.count() == 100000);
+	assert(within(h.percentile(50), 50000, 0.07));
+	assert(within(h.percentile(99), 99000, 0.07));
+	assert(within(h.percentile(99.9), 99900, 0.07));
+	assert(h.percentile(100) == 100000);
+	assert(h.max() == 100000);
+}
+
+void test_histogram_smallValuesExact()
+{
+	LatencyHistogram h;
+	for (std::uint64_t v = 0; v < 32; v++)
+		h.record(v);
+
+	assert(h.percentile(50) == 15);
+	assert(h.max() == 31);
+}
+
+void test_stripedHistogram_concurrentRecording()
+{
+	const int nThreads = 8;
+	const int perThread = 10000;
+
+	StripedLatencyHistogram h;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < nThreads; t++)
+		threads.emplace_back([&, t] {
+			for (int i = 0; i < perThread; i++)
+				h.record(1000 + t);
+		});
+	for (auto &t : threads)
+		t.join();
+
+	// = nothing lost across stripes
+	LatencyHistogram merged = h.snapshot();
+	assert(merged.count() == (std::uint64_t)nThreads * perThread);
+	assert(merged.max() == 1000 + nThreads - 1);
+}
+
+void test_sharedMutex_recordsHoldAndWaitLatency()
+{
+	SharedMutex m("histogram.lock");
+
+	// 1 writer, reader blocked behind it
+	m.lock();
+	std::thread reader = harness.spawn([&] {
+		m.shared_lock();
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		m.shared_unlock();
+	});
+	harness.settle();
+
+	// + writer holds on for at least 2 ms more while the reader waits; the
+	// reader then holds for at least 2 ms
+	std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	m.unlock();
+	reader.join();
+
+	// = one sample each, no shorter than the intervals above
+	SharedMutexStats::Snapshot s = m.statistics().snapshot();
+	assert(s.exclusive.holdLatency.count() == 1);
+	assert(s.exclusive.holdLatency.max() >= 1000000);
+	assert(s.shared.waitLatency.count() == 1);
+	assert(s.shared.waitLatency.max() >= 1000000);
+	assert(s.shared.holdLatency.count() == 1);
+	assert(s.shared.holdLatency.max() >= 1000000);
+}
+
+void test_dumpLatency_textAndJson()
+{
+	SharedMutex m("export.lock");
+	m.lock();
+	m.unlock();
+
+	std::ostringstream text;
+	shared_mutex_stats::dump_latency_text(text);
+	assert(text.str().find("export.lock exclusive hold count=1 p50=") != std::string::npos);
+
+	std::ostringstream json;
+	shared_mutex_stats::dump_latency_json(json);
+	assert(json.str().find("{\"lock\": \"export.lock\", \"mode\": \"exclusive\", \"wait\": {\"count\": 0") != std::string::npos);
+	assert(json.str().find("\"p99.9\": ") != std::string::npos);
+}
+
+int main()
+{
+	test_histogram_percentiles();
+	test_histogram_smallValuesExact();
+	test_stripedHistogram_concurrentRecording();
+	test_sharedMutex_recordsHoldAndWaitLatency();
+	test_dumpLatency_textAndJson();
+	return 0;
+}
@@ -0,0 +1,135 @@
+#define SHARED_MUTEX_LOCKDEP
+#include "SharedMutex.h"
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cassert>
+
+std::vector<std::string> reports;
+
+void test_1reader_lockWriterSameThread_throws()
+{
+	SharedMutex m;
+
+	// 1 reader on this thread
+	m.shared_lock();
+
+	// + lock writer on the same thread
+	bool exception = false;
+	try {
+		m.lock();
+	}
+	catch (std::logic_error &e) {
+		exception = std::string(e.what()).find("would deadlock") != std::string::npos;
+	}
+
+	// = exception instead of a hang, shared lock still held
+	assert(exception == true);
+	m.shared_unlock();
+	m.lock();
+	m.unlock();
+}
+
+void test_1writer_lockSameThread_throws()
+{
+	SharedMutex m;
+	m.lock();
+
+	bool writerException = false;
+	try {
+		m.lock();
+	}
+	catch (std::logic_error &) {
+		writerException = true;
+	}
+
+	bool readerException = false;
+	try {
+		m.shared_lock();
+	}
+	catch (std::logic_error &) {
+		readerException = true;
+	}
+
+	assert(writerException == true);
+	assert(readerException == true);
+	m.unlock();
+}
+
+void test_1reader_lockReaderSameThread_allowed()
+{
+	SharedMutex m;
+
+	m.shared_lock();
+	m.shared_lock();
+	m.shared_unlock();
+	m.shared_unlock();
+
+	assert(reports.empty());
+}
+
+void test_consistentOrder_noReport()
+{
+	SharedMutex a;
+	SharedMutex b;
+
+	for (int i = 0; i < 2; i++) {
+		a.lock();
+		b.shared_lock();
+		b.shared_unlock();
+		a.unlock();
+	}
+
+	assert(reports.empty());
+}
+
+void test_oppositeOrders_reportsCycleWithSites()
+{
+	SharedMutex a;
+	SharedMutex b;
+	SharedMutex c;
+
+	// a -> b, b -> c
+	a.lock();
+	b.lock();
+	b.unlock();
+	a.unlock();
+	b.shared_lock();
+	c.lock();
+	c.unlock();
+	b.shared_unlock();
+	assert(reports.empty());
+
+	// + c -> a closes the cycle
+	c.shared_lock();
+	a.shared_lock();
+	a.shared_unlock();
+	c.shared_unlock();
+
+	// = reported once, naming this file as the acquisition site
+	assert(reports.size() == 1);
+	assert(reports[0].find("lock order cycle") != std::string::npos);
+	assert(reports[0].find(__FILE__) != std::string::npos);
+
+	// + same order again
+	c.shared_lock();
+	a.shared_lock();
+	a.shared_unlock();
+	c.shared_unlock();
+
+	// = no duplicate report
+	assert(reports.size() == 1);
+	reports.clear();
+}
+
+int main()
+{
+	shared_mutex_debug::set_report_handler([](const std::string &report) { reports.push_back(report); });
+
+	test_1reader_lockWriterSameThread_throws();
+	test_1writer_lockSameThread_throws();
+	test_1reader_lockReaderSameThread_allowed();
+	test_consistentOrder_noReport();
+	test_oppositeOrders_reportsCycleWithSites();
+	return 0;
+}
@@ -0,0 +1,177 @@
+// a limit small enough to reach with a handful of readers; the 64-bit range
+// is tested on counts with the default limit
+#define SHARED_MUTEX_MAX_READERS 3
+#include "SharedMutex.h"
+#include "AsyncSharedMutex.h"
+#include "Executors.h"
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <cassert>
+
+template<class F>
+bool throwsOverflow(F f)
+{
+	try {
+		f();
+	}
+	catch (const std::overflow_error &) {
+		return true;
+	}
+	return false;
+}
+
+void test_count_past2pow32()
+{
+	SharedMutexReaderCount<UINT64_MAX> count;
+
+	// + batch of 2^31 readers, then one more
+	count += std::uint64_t(1) << 31;
+	count++;
+
+	// = past int, and past unsigned after another batch
+	assert(count == (std::uint64_t(1) << 31) + 1);
+	count += std::uint64_t(1) << 32;
+	assert(count == (std::uint64_t(3) << 31) + 1);
+	count--;
+	assert(count == std::uint64_t(3) << 31);
+}
+
+void test_count_atMax_throwsAndKeepsCount()
+{
+	SharedMutexReaderCount<UINT64_MAX> count;
+
+	// + fill to one below the maximum
+	count += UINT64_MAX - 1;
+	count++;
+	assert(count == UINT64_MAX);
+
+	// = further readers refused, count does not wrap
+	assert(throwsOverflow([&] { count++; }));
+	assert(throwsOverflow([&] { count += UINT64_MAX; }));
+	assert(count == UINT64_MAX);
+	count--;
+	assert(throwsOverflow([&] { count += 2; }));
+	count++;
+	assert(count == UINT64_MAX);
+}
+
+void test_3readers_sharedLockThrows()
+{
+	SharedMutex m;
+
+	// 3 readers
+	m.shared_lock();
+	assert(m.try_shared_lock() == true);
+	assert(m.try_shared_lock_for(std::chrono::milliseconds(0)) == true);
+
+	// + lock reader
+	// = refused by every shared acquisition, lock state unchanged
+	assert(throwsOverflow([&] { m.shared_lock(); }));
+	assert(throwsOverflow([&] { m.try_shared_lock(); }));
+	assert(throwsOverflow([&] { m.try_shared_lock_for(std::chrono::milliseconds(0)); }));
+	assert(m.try_lock() == false);
+
+	// + unlock reader
+	// = room for one again
+	m.shared_unlock();
+	assert(m.try_shared_lock() == true);
+	m.shared_unlock();
+	m.shared_unlock();
+	m.shared_unlock();
+	assert(m.try_lock() == true);
+	m.unlock();
+}
+
+void test_1writer3queuedReaders_queuedCountAgainstLimit()
+{
+	SharedMutex m;
+	ManualExecutor executor;
+
+	// 1 writer, 3 readers queued behind it
+	m.lock();
+	int readersRan = 0;
+	for (int i = 0; i < 3; i++)
+		m.lock_shared_then([&] { readersRan++; }, executor);
+
+	// + lock reader
+	// = refused before queueing: the writer's unlock must be able to admit all
+	bool fourthRan = false;
+	assert(throwsOverflow([&] { m.lock_shared_then([&] { fourthRan = true; }, executor); }));
+	assert(throwsOverflow([&] { m.shared_lock(); }));
+
+	// + unlock writer
+	// = the 3 queued readers admitted
+	m.unlock();
+	assert(executor.run() == 3);
+	assert(readersRan == 3 && fourthRan == false);
+	for (int i = 0; i < 3; i++)
+		m.shared_unlock();
+	assert(m.try_lock() == true);
+	m.unlock();
+}
+
+// Fire-and-forget coroutine: starts eagerly, frame destroyed on completion.
+struct Task
+{
+	struct promise_type
+	{
+		Task get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+Task lockReader(AsyncSharedMutex &m, bool &acquired, bool &overflowed)
+{
+	try {
+		co_await m.lock_shared_async();
+		acquired = true;
+	}
+	catch (const std::overflow_error &) {
+		overflowed = true;
+	}
+}
+
+Task lockWriter(AsyncSharedMutex &m)
+{
+	co_await m.lock_async();
+}
+
+void test_async_1writer3suspendedReaders_nextReaderThrows()
+{
+	AsyncSharedMutex m;
+	lockWriter(m);
+
+	// 1 writer, 3 suspended readers
+	bool acquired[4] = {};
+	bool overflowed[4] = {};
+	for (int i = 0; i < 3; i++)
+		lockReader(m, acquired[i], overflowed[i]);
+
+	// + lock reader
+	lockReader(m, acquired[3], overflowed[3]);
+
+	// = refused in the coroutine
+	assert(overflowed[3] == true && acquired[3] == false);
+
+	// + unlock writer
+	// = the 3 suspended readers resumed
+	m.unlock();
+	for (int i = 0; i < 3; i++)
+		assert(acquired[i] == true && overflowed[i] == false);
+	for (int i = 0; i < 3; i++)
+		m.shared_unlock();
+}
+
+int main()
+{
+	test_count_past2pow32();
+	test_count_atMax_throwsAndKeepsCount();
+	test_3readers_sharedLockThrows();
+	test_1writer3queuedReaders_queuedCountAgainstLimit();
+	test_async_1writer3suspendedReaders_nextReaderThrows();
+	return 0;
+}
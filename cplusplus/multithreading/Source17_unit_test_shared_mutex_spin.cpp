@@ -0,0 +1,190 @@
+#define SHARED_MUTEX_SPIN
+#define SHARED_MUTEX_SPIN_NS 2000000000   // long enough that a spinner outlasts every holder below
+#define SHARED_MUTEX_TRACE
+#include "SharedMutex.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <cassert>
+
+using shared_mutex_trace::Event;
+using shared_mutex_trace::TraceRecorder;
+
+std::vector<int> allowedCpus()
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	std::vector<int> cpus;
+	if (sched_getaffinity(0, sizeof(set), &set) == 0)
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			if (CPU_ISSET(cpu, &set))
+				cpus.push_back(cpu);
+	return cpus;
+}
+
+// taken before any test pins the main thread
+const std::vector<int> cpus = allowedCpus();
+
+void pinTo(const std::vector<int> &to)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int cpu : to)
+		CPU_SET(cpu, &set);
+	int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	assert(result == 0);
+	(void)result;
+}
+
+int count(TraceRecorder &recorder, Event event)
+{
+	int n = 0;
+	for (auto &entry : recorder.entries())
+		if (entry.record.event == event)
+			n++;
+	return n;
+}
+
+// Returns false if fewer than n events arrived within the timeout.
+bool waitFor(TraceRecorder &recorder, Event event, int n, std::chrono::milliseconds timeout)
+{
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+	while (count(recorder, event) < n) {
+		if (std::chrono::steady_clock::now() > deadline)
+			return false;
+		std::this_thread::yield();
+	}
+	return true;
+}
+
+void busyFor(std::chrono::milliseconds duration)
+{
+	auto end = std::chrono::steady_clock::now() + duration;
+	while (std::chrono::steady_clock::now() < end)
+		;
+}
+
+void test_holderOnSameCpu_waiterParks()
+{
+	int cpu = cpus[0];
+	pinTo({cpu});
+	TraceRecorder recorder;
+	SharedMutex m;
+	m.lock();
+
+	std::thread reader([&] {
+		pinTo({cpu});
+		m.shared_lock();
+		m.shared_unlock();
+	});
+
+	// the reader shares the holder's CPU, so the holder cannot be running
+	// while it checks: it parks at once instead of spinning for 2 s
+	assert(waitFor(recorder, Event::contended_wait, 1, std::chrono::milliseconds(1000)));
+	m.unlock();
+	reader.join();
+	pinTo(cpus);
+}
+
+void test_holderRunningElsewhere_waiterSpinsWithoutParking()
+{
+	if (cpus.size() < 2) {
+		std::printf("skipped: needs 2 CPUs\n");
+		return;
+	}
+	pinTo({cpus[0]});
+	TraceRecorder recorder;
+	SharedMutex m;
+	m.lock();
+
+	std::thread writer([&] {
+		pinTo({cpus[1]});
+		m.lock();
+		m.unlock();
+	});
+
+	assert(waitFor(recorder, Event::acquire_start, 2, std::chrono::milliseconds(1000)));
+	busyFor(std::chrono::milliseconds(20));
+	m.unlock();
+	writer.join();
+
+	pinTo(cpus);
+
+	// = acquired by spinning, never parked
+	assert(count(recorder, Event::contended_wait) == 0);
+	assert(count(recorder, Event::acquire_granted) == 2);
+}
+
+void test_1spinner_otherWaitersPark()
+{
+	if (cpus.size() < 2) {
+		std::printf("skipped: needs 2 CPUs\n");
+		return;
+	}
+	pinTo({cpus[0]});
+	TraceRecorder recorder;
+	SharedMutex m;
+	m.lock();
+
+	auto reader = [&] {
+		pinTo({cpus[1]});
+		m.shared_lock();
+		m.shared_unlock();
+	};
+	std::thread reader1(reader);
+	assert(waitFor(recorder, Event::acquire_start, 2, std::chrono::milliseconds(1000)));
+	std::thread reader2(reader);
+
+	// whichever reader got to spin first keeps spinning, the other parks
+	assert(waitFor(recorder, Event::contended_wait, 1, std::chrono::milliseconds(1000)));
+	m.unlock();
+	reader1.join();
+	reader2.join();
+	pinTo(cpus);
+	assert(count(recorder, Event::contended_wait) == 1);
+}
+
+void test_spinningWaiters_keepMutualExclusion()
+{
+	SharedMutex m;
+	std::atomic<int> writers{0};
+	std::atomic<int> readers{0};
+	long long writes = 0;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 8; t++) {
+		threads.emplace_back([&, t] {
+			for (int i = 0; i < 2000; i++) {
+				if ((t + i) % 4 == 0) {
+					m.lock();
+					assert(++writers == 1 && readers == 0);
+					writes++;
+					writers--;
+					m.unlock();
+				}
+				else {
+					m.shared_lock();
+					readers++;
+					assert(writers == 0);
+					readers--;
+					m.shared_unlock();
+				}
+			}
+		});
+	}
+	for (auto &t : threads)
+		t.join();
+	assert(writes == 8 * 2000 / 4);
+}
+
+int main()
+{
+	test_holderOnSameCpu_waiterParks();
+	test_holderRunningElsewhere_waiterSpinsWithoutParking();
+	test_1spinner_otherWaitersPark();
+	test_spinningWaiters_keepMutualExclusion();
+	return 0;
+}
@@ -0,0 +1,108 @@
+#define SHARED_MUTEX_STATS
+#define SHARED_MUTEX_TRACE
+#include "SharedMutex.h"
+#include "SharedMutexTestHarness.h"
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <cassert>
+
+ThreadHarness harness;
+
+void test_uncontended_countsAcquisitions()
+{
+	SharedMutex m("uncontended");
+
+	m.lock();
+	m.unlock();
+	m.shared_lock();
+	m.shared_lock();
+	m.shared_unlock();
+	m.shared_unlock();
+
+	SharedMutexStats::Snapshot s = m.statistics().snapshot();
+	assert(s.name == "uncontended");
+	assert(s.exclusive.acquisitions == 1);
+	assert(s.exclusive.contended == 0);
+	assert(s.shared.acquisitions == 2);
+	assert(s.shared.contended == 0);
+	assert(s.maxReaders == 2);
+	assert(s.waitNs() == 0);
+}
+
+void test_1reader_lockWriter_countsContendedWait()
+{
+	SharedMutex m("contended");
+
+	// 1 reader, writer blocked behind it
+	m.shared_lock();
+	std::thread writer = harness.spawn([&] { m.lock(); m.unlock(); });
+	harness.settle();
+
+	// + reader holds on for at least 2 ms more, then unlocks
+	std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	m.shared_unlock();
+	writer.join();
+
+	// = contended exclusive acquisition with measurable wait and hold time
+	SharedMutexStats::Snapshot s = m.statistics().snapshot();
+	assert(s.exclusive.acquisitions == 1);
+	assert(s.exclusive.contended == 1);
+	assert(s.exclusive.waitNs > 1000000);
+	assert(s.shared.holdNs > 1000000);
+}
+
+void test_1writer_lockReaders_countsBatchAdmission()
+{
+	SharedMutex m("batch");
+
+	// 1 writer, 2 readers blocked behind it
+	m.lock();
+	std::thread reader1 = harness.spawn([&] { m.shared_lock(); });
+	std::thread reader2 = harness.spawn([&] { m.shared_lock(); });
+	harness.settle();
+	m.unlock();
+	reader1.join();
+	reader2.join();
+
+	// = both readers admitted as contended acquisitions
+	SharedMutexStats::Snapshot s = m.statistics().snapshot();
+	assert(s.shared.acquisitions == 2);
+	assert(s.shared.contended == 2);
+	assert(s.shared.waitNs > 0);
+	assert(s.maxReaders == 2);
+	m.shared_unlock();
+	m.shared_unlock();
+}
+
+void test_dumpHottest_sortedByWaitTime()
+{
+	SharedMutex cold("cold.lock");
+	SharedMutex hot("hot.lock");
+	cold.lock();
+	cold.unlock();
+	hot.lock();
+	std::thread writer = harness.spawn([&] { hot.lock(); hot.unlock(); });
+	harness.settle();
+	hot.unlock();
+	writer.join();
+
+	std::ostringstream os;
+	shared_mutex_stats::dump_hottest(os);
+	std::string table = os.str();
+
+	// = both listed, hottest first
+	assert(table.find("hot.lock") != std::string::npos);
+	assert(table.find("cold.lock") != std::string::npos);
+	assert(table.find("hot.lock") < table.find("cold.lock"));
+}
+
+int main()
+{
+	test_uncontended_countsAcquisitions();
+	test_1reader_lockWriter_countsContendedWait();
+	test_1writer_lockReaders_countsBatchAdmission();
+	test_dumpHottest_sortedByWaitTime();
+	return 0;
+}
@@ -0,0 +1,139 @@
+#define SHARED_MUTEX_TRACE
+#include "SharedMutex.h"
+#include <thread>
+#include <vector>
+#include <cassert>
+
+using shared_mutex_trace::Event;
+using shared_mutex_trace::Mode;
+using shared_mutex_trace::TraceRecorder;
+
+std::vector<Event> events(TraceRecorder &recorder, const void *lock)
+{
+	std::vector<Event> result;
+	for (auto &entry : recorder.entries())
+		if (entry.record.lock == lock)
+			result.push_back(entry.record.event);
+	return result;
+}
+
+int count(TraceRecorder &recorder, Event event, Mode mode)
+{
+	int n = 0;
+	for (auto &entry : recorder.entries())
+		if (entry.record.event == event && entry.record.mode == mode)
+			n++;
+	return n;
+}
+
+// Spins until the recorder has seen `n` contended waits.
+void waitContended(TraceRecorder &recorder, int n)
+{
+	while (count(recorder, Event::contended_wait, Mode::shared) + count(recorder, Event::contended_wait, Mode::exclusive) < n)
+		std::this_thread::yield();
+}
+
+void test_uncontended_startGrantedRelease()
+{
+	TraceRecorder recorder;
+	SharedMutex m;
+
+	m.lock();
+	m.unlock();
+	m.shared_lock();
+	m.shared_unlock();
+
+	std::vector<Event> expected = {
+		Event::acquire_start, Event::acquire_granted, Event::release,
+		Event::acquire_start, Event::acquire_granted, Event::release,
+	};
+	assert(events(recorder, &m) == expected);
+	auto entries = recorder.entries();
+	assert(entries[0].record.mode == Mode::exclusive);
+	assert(entries[3].record.mode == Mode::shared);
+	assert(entries[2].record.wokenReaders == 0 && entries[2].record.wokenWriters == 0);
+}
+
+void test_1writer_lockWriter_waitWakeGranted()
+{
+	TraceRecorder recorder;
+	SharedMutex m;
+
+	m.lock();
+	std::thread writer([&] {
+		m.lock();
+		m.unlock();
+	});
+	waitContended(recorder, 1);
+	m.unlock();
+	writer.join();
+
+	std::vector<Event> expected = {
+		Event::acquire_start, Event::acquire_granted,   // main
+		Event::acquire_start, Event::contended_wait,    // writer
+		Event::release,                                 // main
+		Event::wake, Event::acquire_granted,            // writer
+		Event::release,
+	};
+	assert(events(recorder, &m) == expected);
+	auto entries = recorder.entries();
+	assert(entries[3].record.waitingWriters == 1);
+	assert(entries[4].record.wokenWriters == 1);
+	assert(entries[4].record.wokenReaders == 0);
+	assert(entries[3].thread == entries[5].thread);
+}
+
+void test_1writer_lock2Readers_wokenTogether()
+{
+	TraceRecorder recorder;
+	SharedMutex m;
+
+	m.lock();
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 2; i++) {
+		readers.emplace_back([&] {
+			m.shared_lock();
+			m.shared_unlock();
+		});
+	}
+	waitContended(recorder, 2);
+	m.unlock();
+	for (auto &t : readers)
+		t.join();
+
+	int releases = 0;
+	for (auto &entry : recorder.entries()) {
+		if (entry.record.event == Event::release && entry.record.mode == Mode::exclusive) {
+			assert(entry.record.wokenReaders == 2);
+			assert(entry.record.waitingReaders == 0);
+			releases++;
+		}
+	}
+	assert(releases == 1);
+	assert(count(recorder, Event::wake, Mode::shared) == 2);
+	assert(count(recorder, Event::acquire_granted, Mode::shared) == 2);
+	assert(count(recorder, Event::release, Mode::shared) == 2);
+}
+
+void test_noTracer_noRecords()
+{
+	SharedMutex m;
+	{
+		TraceRecorder recorder;
+		m.lock();
+		m.unlock();
+		assert(events(recorder, &m).size() == 3);
+	}
+	assert(shared_mutex_trace::tracer().load() == nullptr);
+	m.shared_lock();
+	m.shared_unlock();
+}
+
+int main()
+{
+	test_uncontended_startGrantedRelease();
+	test_1writer_lockWriter_waitWakeGranted();
+	test_1writer_lock2Readers_wokenTogether();
+	test_noTracer_noRecords();
+	return 0;
+}
@@ -0,0 +1,116 @@
+#include "SharedMutex.h"
+#include <chrono>
+#include <thread>
+#include <cassert>
+
+using namespace std::chrono_literals;
+
+void test_0readers0writers_tryLock_succeeds()
+{
+	SharedMutex m;
+
+	assert(m.try_lock() == true);
+	assert(m.try_lock() == false);
+	assert(m.try_shared_lock() == false);
+	m.unlock();
+
+	assert(m.try_shared_lock() == true);
+	assert(m.try_shared_lock() == true);
+	assert(m.try_lock() == false);
+	m.shared_unlock();
+	m.shared_unlock();
+	assert(m.try_lock() == true);
+	m.unlock();
+}
+
+void test_1reader_tryLockFor_timesOut()
+{
+	SharedMutex m;
+	m.shared_lock();
+
+	auto begin = std::chrono::steady_clock::now();
+	bool locked = true;
+	std::thread writer([&] {
+		locked = m.try_lock_for(20ms);
+	});
+	writer.join();
+
+	// = gave up after the timeout, lock still usable
+	assert(locked == false);
+	assert(std::chrono::steady_clock::now() - begin >= 20ms);
+	m.shared_unlock();
+	assert(m.try_lock() == true);
+	m.unlock();
+}
+
+void test_1writer_tryLockFor_acquiredOnRelease()
+{
+	SharedMutex m;
+	m.lock();
+
+	bool writerLocked = false;
+	bool readerLocked = false;
+	std::thread writer([&] {
+		writerLocked = m.try_lock_for(10s);
+		if (writerLocked)
+			m.unlock();
+	});
+	std::thread reader([&] {
+		readerLocked = m.try_shared_lock_for(10s);
+		if (readerLocked)
+			m.shared_unlock();
+	});
+	std::this_thread::sleep_for(10ms);
+	m.unlock();
+	writer.join();
+	reader.join();
+
+	assert(writerLocked == true);
+	assert(readerLocked == true);
+}
+
+void test_1writer_trySharedLockFor_timesOut()
+{
+	SharedMutex m;
+	m.lock();
+
+	bool locked = true;
+	std::thread reader([&] {
+		locked = m.try_shared_lock_for(20ms);
+	});
+	reader.join();
+
+	assert(locked == false);
+	m.unlock();
+	assert(m.try_shared_lock_for(0ms) == true);
+	m.shared_unlock();
+}
+
+void test_timedOutWriter_doesNotBlockReaders()
+{
+	SharedMutex m;
+	m.shared_lock();
+	bool locked = true;
+	std::thread writer([&] {
+		locked = m.try_lock_for(1ms);
+	});
+	writer.join();
+	assert(locked == false);
+
+	// no writer left waiting: readers still enter and the lock frees up
+	assert(m.try_shared_lock() == true);
+	m.shared_unlock();
+	m.shared_unlock();
+	assert(m.try_lock() == true);
+	m.unlock();
+}
+
+int main()
+{
+	test_0readers0writers_tryLock_succeeds();
+	test_1reader_tryLockFor_timesOut();
+	test_1writer_tryLockFor_acquiredOnRelease();
+	test_1writer_trySharedLockFor_timesOut();
+	test_timedOutWriter_doesNotBlockReaders();
+	return 0;
+}